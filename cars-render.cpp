@@ -0,0 +1,259 @@
+r32
+calc_car_radius(r32 cell_margin)
+{
+  r32 result = (1 - cell_margin) * 0.35f;
+  return result;
+}
+
+
+u32
+get_car_presentation_hash_slot(u32 car_id, u32 hash_size)
+{
+  u32 result = (car_id * 2654435761) & (hash_size - 1);
+  return result;
+}
+
+
+CarPresentation *
+find_car_presentation_slot(CarPresentation *hash, u32 hash_size, u32 car_id)
+{
+  u32 slot = get_car_presentation_hash_slot(car_id, hash_size);
+  while (hash[slot].used && hash[slot].car_id != car_id)
+  {
+    slot = (slot + 1) & (hash_size - 1);
+  }
+  return hash + slot;
+}
+
+
+CarPresentation *
+find_car_presentation(CarPresentations *presentations, u32 car_id)
+{
+  CarPresentation *result = 0;
+
+  if (presentations->hash)
+  {
+    CarPresentation *presentation = find_car_presentation_slot(presentations->hash, presentations->hash_size, car_id);
+    if (presentation->used)
+    {
+      result = presentation;
+    }
+  }
+
+  return result;
+}
+
+
+void
+rebuild_car_presentations(Memory *memory, CarPresentations *presentations, u32 n_cars)
+{
+  u32 new_hash_size = max(presentations->hash_size, INITIAL_CAR_PRESENTATIONS_HASH_SIZE);
+  while (4 * n_cars > new_hash_size)
+  {
+    new_hash_size *= 2;
+  }
+
+  CarPresentation *new_hash;
+  CarPresentation *new_spare_hash;
+  if (new_hash_size == presentations->hash_size)
+  {
+    new_hash = presentations->spare_hash;
+    new_spare_hash = presentations->hash;
+  }
+  else
+  {
+    log(L_Render, u8("Growing car presentations hash to %u slots"), new_hash_size);
+
+    // NOTE: The old tables are left in the arena, like the chunk hash.
+    new_hash = push_structs(memory, CarPresentation, new_hash_size);
+    new_spare_hash = push_structs(memory, CarPresentation, new_hash_size);
+  }
+
+  zero_n(new_hash, CarPresentation, new_hash_size);
+  u32 n_entries = 0;
+
+  for (u32 slot = 0;
+       slot < presentations->hash_size;
+       ++slot)
+  {
+    CarPresentation *presentation = presentations->hash + slot;
+    if (presentation->used &&
+        presentation->last_seen_frame + 1 == presentations->frame)
+    {
+      *find_car_presentation_slot(new_hash, new_hash_size, presentation->car_id) = *presentation;
+      ++n_entries;
+    }
+  }
+
+  presentations->hash = new_hash;
+  presentations->spare_hash = new_spare_hash;
+  presentations->hash_size = new_hash_size;
+  presentations->n_entries = n_entries;
+}
+
+
+CarPresentation *
+get_car_presentation(GameState *game_state, Car car, u64 time_us)
+{
+  CarPresentations *presentations = &game_state->car_presentations;
+
+  CarPresentation *presentation = find_car_presentation_slot(presentations->hash, presentations->hash_size, *car_id(car));
+  if (!presentation->used)
+  {
+    presentation->used = true;
+    presentation->car_id = *car_id(car);
+    presentation->cell_x = *car_cell_x(car);
+    presentation->cell_y = *car_cell_y(car);
+    presentation->offset = (vec2){0, 0};
+    ++presentations->n_entries;
+
+    WorldSpace pos = {presentation->cell_x, presentation->cell_y, presentation->offset};
+    presentation->particle_source = new_particle_source(&(game_state->particles), pos, PS_GROW, time_us);
+    presentation->particle_source->ttl = CAR_PARTICLE_SOURCE_KEEP_ALIVE;
+    presentation->particle_source->particle_prototype.grow.initial_radius = calc_car_radius(game_state->cell_margin);
+    presentation->particle_source->particle_prototype.bitmap = &(game_state->particles.smoke_bitmap);
+  }
+
+  return presentation;
+}
+
+
+WorldSpace
+get_car_world_pos(CarPresentations *presentations, Car car)
+{
+  WorldSpace result = {*car_cell_x(car), *car_cell_y(car), (vec2){0, 0}};
+
+  CarPresentation *presentation = find_car_presentation(presentations, *car_id(car));
+  if (presentation)
+  {
+    result.offset = presentation->offset;
+  }
+
+  return result;
+}
+
+
+void
+update_car_position(GameState *game_state, CarPresentation *presentation, Car car, u32 last_frame_dt)
+{
+  vec2 *offset = &presentation->offset;
+
+  if (presentation->cell_x != *car_cell_x(car) ||
+      presentation->cell_y != *car_cell_y(car))
+  {
+    // NOTE: The offset is set to place the car in the centre of the cell
+    //         it was previously in, and is then moved back to zero.
+    *offset = (vec2){(r32)((s64)presentation->cell_x - *car_cell_x(car)),
+                     (r32)((s64)presentation->cell_y - *car_cell_y(car))};
+    presentation->cell_x = *car_cell_x(car);
+    presentation->cell_y = *car_cell_y(car);
+  }
+
+#if 1
+  r32 speed = (last_frame_dt / 1000000.0) * game_state->sim_ticks_per_s;
+  vec2 direction = -unit_vector(*offset);
+
+  vec2 movement = direction * speed;
+
+  if (abs(offset->x) >= abs(movement.x))
+  {
+    offset->x += movement.x;
+  }
+  else
+  {
+    offset->x = 0;
+  }
+
+  if (abs(offset->y) >= abs(movement.y))
+  {
+    offset->y += movement.y;
+  }
+  else
+  {
+    offset->y = 0;
+  }
+
+#else
+  *offset = (vec2){0};
+#endif
+}
+
+
+void
+annimate_cars(Memory *memory, GameState *game_state, u64 time_us, u32 last_frame_dt)
+{
+  CarPresentations *presentations = &game_state->car_presentations;
+  Cars *cars = &game_state->sim->cars;
+
+  ++presentations->frame;
+
+  u32 n_cars = get_n_cars(cars);
+
+  if (2 * (presentations->n_entries + n_cars) > presentations->hash_size)
+  {
+    rebuild_car_presentations(memory, presentations, n_cars);
+  }
+
+  CarsIterator iter = {};
+  Car car;
+  while (cars_iterator(cars, &iter, &car))
+  {
+    CarPresentation *presentation = get_car_presentation(game_state, car, time_us);
+    presentation->last_seen_frame = presentations->frame;
+
+    update_car_position(game_state, presentation, car, last_frame_dt);
+
+    // Update this car's particle source to match the cars position,
+    //   and keep it alive for another frame.
+    presentation->particle_source->pos = (WorldSpace){presentation->cell_x, presentation->cell_y, presentation->offset};
+    presentation->particle_source->t0 = time_us;
+  }
+}
+
+
+void
+draw_car(GameState *game_state, RenderWindow *render_window, Car car, u64 time_us, vec4 colour = (vec4){1, 0.60, 0.13, 0.47})
+{
+  r32 car_radius = calc_car_radius(game_state->cell_margin);
+
+  vec2 pos = world_coord_to_render_window_coord(render_window, get_car_world_pos(&game_state->car_presentations, car));
+
+  glPushMatrix();
+    glTranslatef(pos.x, pos.y, 0);
+
+    glPushMatrix();
+      glScalef(car_radius, car_radius, 1);
+      glColor3f(colour.r, colour.g, colour.b);
+
+      draw_circle();
+    glPopMatrix();
+
+    u32 max_len = 16;
+    u8 str[max_len];
+    r32 font_size = 0.15;
+
+    u32 chars = formatted_string(str, max_len, u8("%d"), *car_value(car));
+    font_size /= chars;
+
+    // draw_string(&game_state->bitmaps.font, pos - 0.5*Vec2(chars, 1)*CHAR_SIZE*game_state->world_per_pixel*font_size, str, font_size);
+  glPopMatrix();
+}
+
+
+void
+draw_cars(GameState *game_state, RenderWindow *render_window, Cars *cars, u64 time_us)
+{
+  // TODO: Loop through only relevant cars?
+  //       i.e.: spacial partitioning the storage.
+  //       Store the cars in the quad-tree?
+  CarsIterator iter = {};
+  Car car;
+  while (cars_iterator(cars, &iter, &car))
+  {
+#ifdef DEBUG_BLOCK_COLORS
+    draw_car(game_state, render_window, car, time_us, iter.cars_block->c);
+#else
+    draw_car(game_state, render_window, car, time_us);
+#endif
+  }
+}
\ No newline at end of file
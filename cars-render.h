@@ -0,0 +1,45 @@
+r32
+calc_car_radius(r32);
+
+
+// The sim's car storage doesn't hold anything only needed for drawing,
+//   so the GUI keeps each car's presentation in a hash table keyed by
+//   car id:
+// - Entries are created the first frame a car is seen
+// - The car's last cell is kept, so when it moves it can be animated
+//     in from there
+// - Particle sources are kept alive each frame, so they run out on
+//     their own once their car is removed
+// - When the table is half full it is rebuilt with only the cars seen
+//     in the last frame
+
+const u32 INITIAL_CAR_PRESENTATIONS_HASH_SIZE = 1024;  // Must be a power of two
+const u32 CAR_PARTICLE_SOURCE_KEEP_ALIVE = seconds_in_u(0.2);
+
+
+struct CarPresentation
+{
+  u32 car_id;
+  b32 used;
+  u32 last_seen_frame;
+
+  u32 cell_x;
+  u32 cell_y;
+  vec2 offset;
+
+  ParticleSource *particle_source;
+};
+
+
+struct CarPresentations
+{
+  CarPresentation *hash;
+  u32 hash_size;
+  u32 n_entries;
+
+  // NOTE: Rebuilds at the same size swap between hash and spare_hash,
+  //         so they don't use up the arena.
+  CarPresentation *spare_hash;
+
+  u32 frame;
+};
\ No newline at end of file
@@ -1,4 +1,151 @@
-Car *
+//
+// Car accessors
+//
+
+s32 *
+car_value(Car car)
+{
+  return car.block->values + car.index;
+}
+
+
+u32 *
+car_cell_x(Car car)
+{
+  return car.block->cell_xs + car.index;
+}
+
+
+u32 *
+car_cell_y(Car car)
+{
+  return car.block->cell_ys + car.index;
+}
+
+
+Cell **
+car_cell(Car car)
+{
+  return car.block->cells + car.index;
+}
+
+
+u8 *
+car_pause_left(Car car)
+{
+  return car.block->pause_lefts + car.index;
+}
+
+
+u32 *
+car_skip_ticks(Car car)
+{
+  return car.block->skip_ticks + car.index;
+}
+
+
+u64 *
+car_count(Car car)
+{
+  return car.block->counts + car.index;
+}
+
+
+CarDirection
+get_car_direction(Car car)
+{
+  CarDirection result = (CarDirection)(car.block->directions[car.index] & CAR_DIRECTION_MASK);
+  return result;
+}
+
+
+void
+set_car_direction(Car car, CarDirection direction)
+{
+  u8 *directions = car.block->directions + car.index;
+  *directions = (*directions & ~CAR_DIRECTION_MASK) | direction;
+}
+
+
+CarDirection
+get_car_unpause_direction(Car car)
+{
+  CarDirection result = (CarDirection)((car.block->directions[car.index] >> CAR_DIRECTION_BITS) & CAR_DIRECTION_MASK);
+  return result;
+}
+
+
+void
+set_car_unpause_direction(Car car, CarDirection direction)
+{
+  u8 *directions = car.block->directions + car.index;
+  *directions = (*directions & CAR_DIRECTION_MASK) | (direction << CAR_DIRECTION_BITS);
+}
+
+
+b32
+get_car_flag(Car car, u8 flag)
+{
+  b32 result = (car.block->flags[car.index] & flag) != 0;
+  return result;
+}
+
+
+void
+set_car_flag(Car car, u8 flag, b32 value)
+{
+  if (value)
+  {
+    car.block->flags[car.index] |= flag;
+  }
+  else
+  {
+    car.block->flags[car.index] &= ~flag;
+  }
+}
+
+
+u32 *
+car_id(Car car)
+{
+  return car.block->ids + car.index;
+}
+
+
+const vec2 CAR_DIRECTION_VECTORS[] = {
+  UP,         // CAR_UP
+  DOWN,       // CAR_DOWN
+  RIGHT,      // CAR_RIGHT
+  LEFT,       // CAR_LEFT
+  STATIONARY  // CAR_STATIONARY
+};
+
+
+CarDirection
+get_car_direction_from_vector(vec2 direction)
+{
+  CarDirection result = CAR_STATIONARY;
+
+  for (u32 car_direction = 0;
+       car_direction < array_count(CAR_DIRECTION_VECTORS);
+       ++car_direction)
+  {
+    if (CAR_DIRECTION_VECTORS[car_direction] == direction)
+    {
+      result = (CarDirection)car_direction;
+      break;
+    }
+  }
+
+  return result;
+}
+
+
+//
+// Car storage
+//
+
+Car
 get_new_car(Memory *memory, Cars *cars)
 {
   CarsBlock *block = cars->first_block;
@@ -35,7 +182,7 @@ get_new_car(Memory *memory, Cars *cars)
     cars->first_block = block;
   }
 
-  Car *result = block->cars + block->next_free_in_block++;
+  Car result = {block, block->next_free_in_block++};
   return result;
 }
 
@@ -46,29 +193,9 @@ delete_all_cars(Cars *cars)
   CarsBlock *block = cars->first_block;
   if (block)
   {
-    while (true)
+    while (block->next_block)
     {
-      // Clear partical sources
-      Car *car;
-      for (u32 car_index = 0;
-           car_index < block->next_free_in_block;
-           ++car_index)
-      {
-        car = block->cars + car_index;
-        if (car->particle_source)
-        {
-          car->particle_source->t0 = 0;
-        }
-      }
-
-      if (block->next_block)
-      {
-        block = block->next_block;
-      }
-      else
-      {
-        break;
-      }
+      block = block->next_block;
     }
 
     // Put free chain on end of current block chain,
@@ -81,15 +208,31 @@ delete_all_cars(Cars *cars)
 
 
 void
-rm_car(CarsBlock *block, u32 index_in_block)
+copy_car(Car to, Car from)
 {
-  Car *car = block->cars + index_in_block;
-  car->particle_source->t0 = 0;
+  to.block->values[to.index]       = from.block->values[from.index];
+  to.block->cell_xs[to.index]      = from.block->cell_xs[from.index];
+  to.block->cell_ys[to.index]      = from.block->cell_ys[from.index];
+  to.block->cells[to.index]        = from.block->cells[from.index];
+  to.block->directions[to.index]   = from.block->directions[from.index];
+  to.block->pause_lefts[to.index]  = from.block->pause_lefts[from.index];
+  to.block->skip_ticks[to.index]   = from.block->skip_ticks[from.index];
+  to.block->flags[to.index]        = from.block->flags[from.index];
+  to.block->counts[to.index]       = from.block->counts[from.index];
+  to.block->ids[to.index]          = from.block->ids[from.index];
+}
 
+
+void
+rm_car(CarsBlock *block, u32 index_in_block)
+{
   --block->next_free_in_block;
-  if (index_in_block != block->next_free_in_block)
+  u32 last = block->next_free_in_block;
+  if (index_in_block != last)
   {
-    *car = block->cars[block->next_free_in_block];
+    Car to = {block, index_in_block};
+    Car from = {block, last};
+    copy_car(to, from);
   }
 }
 
@@ -104,9 +247,7 @@ update_dead_cars(Cars *cars)
 
   while (cars_block)
   {
-    Car *car = cars_block->cars + first_car_not_checked_in_block;
-
-    if (car->dead)
+    if (cars_block->flags[first_car_not_checked_in_block] & CAR_FLAG_DEAD)
     {
       log(L_CarsStorage, u8("Deleting car"));
       rm_car(cars_block, first_car_not_checked_in_block);
@@ -151,10 +292,10 @@ update_dead_cars(Cars *cars)
 }
 
 
-Car *
-cars_iterator(Cars *cars, CarsIterator *iterator)
+b32
+cars_iterator(Cars *cars, CarsIterator *iterator, Car *result)
 {
-  Car *result = 0;
+  b32 found = false;
 
   // Check if this is a new iterator
   if (iterator->cars_block == 0)
@@ -173,29 +314,313 @@ cars_iterator(Cars *cars, CarsIterator *iterator)
   // Check we haven't reached the end
   if (iterator->cars_block)
   {
-    result = iterator->cars_block->cars + iterator->car_index;
+    result->block = iterator->cars_block;
+    result->index = iterator->car_index;
     ++iterator->car_index;
+    found = true;
   }
 
-  return result;
+  return found;
 }
 
 
-Car *
-get_car_with_id(Cars *cars, u32 car_id)
+b32
+get_car_with_id(Cars *cars, u32 id, Car *result)
 {
-  Car *result = 0;
+  b32 found = false;
   CarsIterator iter = {};
-  Car *car;
+  Car car;
 
-  while ((car = cars_iterator(cars, &iter)))
+  while (cars_iterator(cars, &iter, &car))
   {
-    if (car->id == car_id)
+    if (*car_id(car) == id)
     {
-      result = car;
+      *result = car;
+      found = true;
       break;
     }
   }
 
+  return found;
+}
+
+
+u32
+get_n_cars(Cars *cars)
+{
+  u32 result = 0;
+
+  CarsBlock *block = cars->first_block;
+  while (block)
+  {
+    result += block->next_free_in_block;
+    block = block->next_block;
+  }
+
+  return result;
+}
+
+
+// The pause left is worked out from the ticks a paused car is held for,
+//   see "Paused cars" in cars-storage.h.
+u8
+get_car_pause_left(Car car)
+{
+  u8 result = *car_pause_left(car);
+
+  if (result && get_car_unpause_direction(car) != CAR_STATIONARY)
+  {
+    result += *car_skip_ticks(car);
+  }
+
+  return result;
+}
+
+
+//
+// Merging identical cars
+//
+
+u32
+get_car_state_hash_slot(Car car, u32 hash_size)
+{
+  u32 result = ((*car_cell_x(car) * 73856093) ^
+                (*car_cell_y(car) * 19349663) ^
+                ((u32)*car_value(car) * 83492791) ^
+                (car.block->directions[car.index] * 2654435761) ^
+                (*car_skip_ticks(car) * 40503)) & (hash_size - 1);
+  return result;
+}
+
+
+b32
+car_states_equal(Car a, Car b)
+{
+  b32 result = (*car_cell_x(a) == *car_cell_x(b) &&
+                *car_cell_y(a) == *car_cell_y(b) &&
+                *car_value(a) == *car_value(b) &&
+                a.block->directions[a.index] == b.block->directions[b.index] &&
+                *car_pause_left(a) == *car_pause_left(b) &&
+                *car_skip_ticks(a) == *car_skip_ticks(b) &&
+                a.block->flags[a.index] == b.block->flags[b.index]);
+  return result;
+}
+
+
+void
+merge_identical_cars(Memory *memory, Cars *cars)
+{
+  u32 n_cars = 0;
+  CarsBlock *block = cars->first_block;
+  while (block)
+  {
+    n_cars += block->next_free_in_block;
+    block = block->next_block;
+  }
+
+  if (2 * n_cars > cars->merge_hash_size)
+  {
+    u32 new_hash_size = cars->merge_hash_size ? cars->merge_hash_size : INITIAL_CAR_MERGE_HASH_SIZE;
+    while (2 * n_cars > new_hash_size)
+    {
+      new_hash_size *= 2;
+    }
+    log(L_CarsStorage, u8("Growing car merge hash to %u slots"), new_hash_size);
+
+    // NOTE: The old table is left in the arena, like the chunk hash.
+    cars->merge_hash = push_structs(memory, Car, new_hash_size);
+    cars->merge_hash_size = new_hash_size;
+  }
+
+  if (n_cars)
+  {
+    zero_n(cars->merge_hash, Car, cars->merge_hash_size);
+
+    b32 merged_any = false;
+
+    for (block = cars->first_block;
+         block;
+         block = block->next_block)
+    {
+      for (u32 car_index = 0;
+           car_index < block->next_free_in_block;
+           ++car_index)
+      {
+        Car car = {block, car_index};
+
+        u32 slot = get_car_state_hash_slot(car, cars->merge_hash_size);
+        while (cars->merge_hash[slot].block)
+        {
+          Car group = cars->merge_hash[slot];
+          if (car_states_equal(group, car))
+          {
+            *car_count(group) += *car_count(car);
+            set_car_flag(car, CAR_FLAG_DEAD, true);
+            merged_any = true;
+            break;
+          }
+          slot = (slot + 1) & (cars->merge_hash_size - 1);
+        }
+
+        if (!get_car_flag(car, CAR_FLAG_DEAD))
+        {
+          cars->merge_hash[slot] = car;
+        }
+      }
+    }
+
+    if (merged_any)
+    {
+      log(L_CarsStorage, u8("Merged identical cars"));
+      update_dead_cars(cars);
+    }
+  }
+}
+
+
+u32
+get_car_occupancy_hash_slot(u32 cell_x, u32 cell_y)
+{
+  u32 result = ((cell_x * 73856093) ^ (cell_y * 19349663)) & (CAR_OCCUPANCY_HASH_SIZE - 1);
+  return result;
+}
+
+
+CarOccupancyEntry *
+get_car_occupancy_entry(CarOccupancy *occupancy, u32 cell_x, u32 cell_y)
+{
+  CarOccupancyEntry *result = 0;
+
+  if (occupancy->hash_table)
+  {
+    CarOccupancyEntry *entry = occupancy->hash_table[get_car_occupancy_hash_slot(cell_x, cell_y)];
+    while (entry)
+    {
+      if (entry->cell_x == cell_x && entry->cell_y == cell_y)
+      {
+        result = entry;
+        break;
+      }
+      entry = entry->next_in_hash;
+    }
+  }
+
+  return result;
+}
+
+
+void
+add_car_to_occupancy(Memory *memory, CarOccupancy *occupancy, u32 cell_x, u32 cell_y)
+{
+  if (!occupancy->hash_table)
+  {
+    occupancy->hash_table = push_structs(memory, CarOccupancyEntry *, CAR_OCCUPANCY_HASH_SIZE);
+    zero_n(occupancy->hash_table, CarOccupancyEntry *, CAR_OCCUPANCY_HASH_SIZE);
+  }
+
+  CarOccupancyEntry *entry = get_car_occupancy_entry(occupancy, cell_x, cell_y);
+  if (!entry)
+  {
+    CarOccupancyBlock *block = occupancy->first_block;
+    if (!block || block->next_free_in_block == CAR_OCCUPANCY_ENTRIES_PER_BLOCK)
+    {
+      if (occupancy->free_chain)
+      {
+        block = occupancy->free_chain;
+        occupancy->free_chain = block->next_block;
+      }
+      else
+      {
+        block = push_struct(memory, CarOccupancyBlock);
+        log(L_CarsStorage, u8("Allocating new car occupancy block"));
+      }
+
+      block->next_free_in_block = 0;
+
+      block->next_block = occupancy->first_block;
+      occupancy->first_block = block;
+    }
+
+    entry = block->entries + block->next_free_in_block++;
+    entry->cell_x = cell_x;
+    entry->cell_y = cell_y;
+    entry->n_cars = 0;
+
+    CarOccupancyEntry **hash_slot = occupancy->hash_table + get_car_occupancy_hash_slot(cell_x, cell_y);
+    entry->next_in_hash = *hash_slot;
+    *hash_slot = entry;
+  }
+
+  ++entry->n_cars;
+}
+
+
+void
+clear_car_occupancy(CarOccupancy *occupancy)
+{
+  // Only clear the hash slots which are in use, instead of the whole
+  //   table.
+
+  CarOccupancyBlock *block = occupancy->first_block;
+  if (block)
+  {
+    while (true)
+    {
+      for (u32 entry_index = 0;
+           entry_index < block->next_free_in_block;
+           ++entry_index)
+      {
+        CarOccupancyEntry *entry = block->entries + entry_index;
+        occupancy->hash_table[get_car_occupancy_hash_slot(entry->cell_x, entry->cell_y)] = 0;
+      }
+
+      if (block->next_block)
+      {
+        block = block->next_block;
+      }
+      else
+      {
+        break;
+      }
+    }
+
+    block->next_block = occupancy->free_chain;
+    occupancy->free_chain = occupancy->first_block;
+    occupancy->first_block = 0;
+  }
+}
+
+
+void
+rebuild_car_occupancy(Memory *memory, Cars *cars)
+{
+  clear_car_occupancy(&cars->occupancy);
+
+  CarsIterator iter = {};
+  Car car;
+  while (cars_iterator(cars, &iter, &car))
+  {
+    // NOTE: Cars in transit through a corridor or loop are positioned
+    //         at the end of it, but really they are on cells which can't
+    //         be detected.
+    if (*car_skip_ticks(car) == 0)
+    {
+      add_car_to_occupancy(memory, &cars->occupancy, *car_cell_x(car), *car_cell_y(car));
+    }
+  }
+}
+
+
+u32
+cars_on_cell(CarOccupancy *occupancy, u32 cell_x, u32 cell_y)
+{
+  u32 result = 0;
+
+  CarOccupancyEntry *entry = get_car_occupancy_entry(occupancy, cell_x, cell_y);
+  if (entry)
+  {
+    result = entry->n_cars;
+  }
+
   return result;
 }
\ No newline at end of file
@@ -21,30 +21,63 @@ const u32 CARS_PER_BLOCK = 512;
 //         - Re-link previous block to next block
 
 
-struct Car
-{
-  b32 update_next_frame;
-  b32 dead;
-  u32 id;
+//
+// Cars in a block are stored as a structure of arrays:
+// - Hot arrays hold the state used by the sim each tick, packed as
+//     small as possible
+// - The cold ids array is only used to match cars up with their
+//     presentation and UI state, which the front end keeps itself
+//
+// Cars are accessed through Car handles (block + index) and the
+//   car_*() accessors in cars-storage.cpp.
 
-  s32 value;
 
-  WorldSpace cell_pos;
+// Cached cells:
+//
+// Each car keeps a pointer to the cell it is on, so the cars tick
+//   doesn't look the cell up in the chunk hash for both the interaction
+//   and the move.
+//
+// - Cells don't move while the sim runs, chunks are only ordered, pruned
+//     or cleared as a maze is loaded, and loading deletes all the cars
+// - A move within a chunk steps the pointer, moves into another chunk
+//     and jumps through corridors clear it, and it is looked up again by
+//     get_car_cell() when next needed
 
-  vec2 direction;
 
-  u32 pause_left;
-  vec2 unpause_direction;
+// Order matches CellNeighbour, the opposite direction is (direction ^ 1).
+enum CarDirection
+{
+  CAR_UP,
+  CAR_DOWN,
+  CAR_RIGHT,
+  CAR_LEFT,
+  CAR_STATIONARY
+};
 
-  CellType updated_cell_type;
+const u8 CAR_DIRECTION_BITS = 3;
+const u8 CAR_DIRECTION_MASK = (1 << CAR_DIRECTION_BITS) - 1;
 
-  ParticleSource *particle_source;
-};
+const u8 CAR_FLAG_DEAD              = 1 << 0;
+const u8 CAR_FLAG_UPDATE_NEXT_FRAME = 1 << 1;
 
 
 struct CarsBlock
 {
-  Car cars[CARS_PER_BLOCK];
+  // Hot
+  s32 values[CARS_PER_BLOCK];
+  u32 cell_xs[CARS_PER_BLOCK];
+  u32 cell_ys[CARS_PER_BLOCK];
+  Cell *cells[CARS_PER_BLOCK];  // The cell the car is on, 0 until it is looked up
+  u8 directions[CARS_PER_BLOCK];  // CarDirection, with the unpause direction in the high bits
+  u8 pause_lefts[CARS_PER_BLOCK];
+  u32 skip_ticks[CARS_PER_BLOCK];  // Ticks left in transit through a corridor or loop, or paused
+  u8 flags[CARS_PER_BLOCK];
+  u64 counts[CARS_PER_BLOCK];  // Number of identical cars this entry stands for
+
+  // Cold
+  u32 ids[CARS_PER_BLOCK];
+
   u32 next_free_in_block;
   CarsBlock *next_block;
 
@@ -54,10 +87,101 @@ struct CarsBlock
 };
 
 
+struct Car
+{
+  CarsBlock *block;
+  u32 index;
+};
+
+
+// Car occupancy is a spatial index of the number of cars on each
+//   cell, so neighbourhood queries don't need to loop through every
+//   car.
+//
+// - Chained hash table keyed by cell position
+// - Entries allocated from blocks, blocks are put on a free chain
+//     when the occupancy is cleared
+// - Rebuilt at the start of each sim tick, cars spawned during the
+//     tick are added incrementally
+
+const u32 CAR_OCCUPANCY_HASH_SIZE = 65536;  // Must be a power of two
+const u32 CAR_OCCUPANCY_ENTRIES_PER_BLOCK = 1024;
+
+
+struct CarOccupancyEntry
+{
+  u32 cell_x;
+  u32 cell_y;
+  u32 n_cars;
+
+  CarOccupancyEntry *next_in_hash;
+};
+
+
+struct CarOccupancyBlock
+{
+  CarOccupancyEntry entries[CAR_OCCUPANCY_ENTRIES_PER_BLOCK];
+  u32 next_free_in_block;
+  CarOccupancyBlock *next_block;
+};
+
+
+struct CarOccupancy
+{
+  CarOccupancyEntry **hash_table;
+
+  CarOccupancyBlock *first_block;
+  CarOccupancyBlock *free_chain;
+};
+
+
+// Merging identical cars:
+//
+// Splitter trees double the number of cars at every splitter, even
+//   when the new cars end up in exactly the same state. When
+//   merge_identical is set, cars with the same cell, direction, value,
+//   pause and transit state are merged into one entry after each tick,
+//   with the counts added together.
+//
+// - The sim is deterministic, so once merged the cars stay identical
+// - Holes kill the whole group, outputs print the value once per car
+// - Detect cells only test for presence, so the occupancy counts
+//     groups rather than cars
+// - An input box is shown once for the whole group
+
+const u32 INITIAL_CAR_MERGE_HASH_SIZE = 1024;
+
+
+// Paused cars:
+//
+// A car starting a pause on a CELL_PAUSE cell has nothing to do until
+//   the pause ends, so it is held in transit like a car in a corridor,
+//   with skip_ticks set to the length of the pause. It keeps its place
+//   in the block chain, so the cars are updated in the same order.
+//
+// - A pause of 0 still holds the car for one tick
+// - While the car is held its pause_left is 1, or 0 for a pause of 0, so
+//     the pause cell ends the pause when the car is next updated
+// - get_car_pause_left() gives the pause left, from the ticks left
+
+
 struct Cars
 {
   CarsBlock *first_block;
   CarsBlock *free_chain;
+
+  CarOccupancy occupancy;
+
+  // NOTE: Ids aren't reset when the cars are deleted, so a restarted
+  //         car is never mistaken for a car from the last run.
+  u32 next_car_id;
+
+  b32 merge_identical;
+
+  // Open addressed hash table of cars, keyed by car state, rebuilt by
+  //   each merge
+  Car *merge_hash;
+  u32 merge_hash_size;
 };
 
 
@@ -1,138 +1,189 @@
-r32
-calc_car_radius(r32 cell_margin)
+void
+init_car(Cars *cars, Car car, u32 cell_x, u32 cell_y, CarDirection direction = CAR_DOWN)
 {
-  r32 result = (1 - cell_margin) * 0.35f;
-  return result;
+  car.block->flags[car.index] = 0;
+  *car_value(car) = 0;
+  *car_cell_x(car) = cell_x;
+  *car_cell_y(car) = cell_y;
+  *car_cell(car) = 0;
+  set_car_direction(car, direction);
+  set_car_unpause_direction(car, CAR_STATIONARY);
+  *car_pause_left(car) = 0;
+  *car_skip_ticks(car) = 0;
+  *car_count(car) = 1;
+  *car_id(car) = cars->next_car_id++;
 }
 
 
-void
-init_car(GameState *game_state, u64 time_us, Car *car, u32 cell_x, u32 cell_y, vec2 direction = DOWN)
+// NOTE: Can be called from several threads at once in the same way as
+//         get_cell(maze, x, y, last_chunk).
+Cell *
+get_car_cell(Maze *maze, Car car, CellChunk **last_chunk)
 {
-  car->update_next_frame = false;
-  car->dead = false;
-  car->value = 0;
-  static u32 cars_id = 0;
-  car->id = cars_id++;
-  car->cell_pos.cell_x = cell_x;
-  car->cell_pos.cell_y = cell_y;
-  car->cell_pos.offset = (vec2){0, 0};
-  car->direction = direction;
-  car->pause_left = 0;
-  car->unpause_direction = STATIONARY;
-  car->updated_cell_type = CELL_NULL;
-
-  car->particle_source = new_particle_source(&(game_state->particles), car->cell_pos, PS_GROW, time_us);
-  car->particle_source->particle_prototype.grow.initial_radius = calc_car_radius(game_state->cell_margin);
-  car->particle_source->particle_prototype.bitmap = &(game_state->particles.smoke_bitmap);
+  Cell **cell = car_cell(car);
+  if (!*cell)
+  {
+    *cell = get_cell(maze, *car_cell_x(car), *car_cell_y(car), last_chunk);
+  }
+
+  return *cell;
 }
 
 
-void
-move_car(GameState *game_state, Maze *maze, Car *car)
+// Returns false if the car can't move off the cell
+b32
+get_car_move(Cell *cell, CarDirection direction, CarDirection *result)
 {
-  if (car->direction == STATIONARY)
+  b32 can_move = false;
+
+  if (direction == CAR_STATIONARY)
   {
     // They're stuck this way, FOREVER!
   }
   else
   {
-    vec2 dir_components[] = {UP, DOWN, LEFT, RIGHT};
-
-    vec2 directions[4];
-    directions[0] = car->direction;
-    directions[3] = -car->direction;
-
-    u32 i = 1;
-    for (u32 direction_index = 0;
-         direction_index < 4;
-         direction_index++)
+    // Try straight on, then the perpendicular directions, then reverse.
+    CarDirection directions[4];
+    directions[0] = direction;
+    if (direction == CAR_UP || direction == CAR_DOWN)
     {
-      vec2 test_direction = dir_components[direction_index];
-
-      if ((test_direction != directions[0]) &&
-          (test_direction != directions[3]))
-      {
-        directions[i++] = test_direction;
-      }
+      directions[1] = CAR_LEFT;
+      directions[2] = CAR_RIGHT;
+    }
+    else
+    {
+      directions[1] = CAR_UP;
+      directions[2] = CAR_DOWN;
     }
+    directions[3] = (CarDirection)(direction ^ 1);
 
-    b32 can_move = false;
     for (u32 direction_index = 0;
          direction_index < 4;
          direction_index++)
     {
-      vec2 test_direction = directions[direction_index];
+      CarDirection test_direction = directions[direction_index];
 
-      Cell *test_cell = get_cell(maze, (car->cell_pos.cell_x + test_direction.x), (car->cell_pos.cell_y + test_direction.y));
-      if (test_cell &&
-          test_cell->type != CELL_WALL &&
-          test_cell->type != CELL_NULL)
+      if (get_neighbour_state(cell, (CellNeighbour)test_direction) == WALKABLE)
       {
         can_move = true;
-        car->direction = test_direction;
+        *result = test_direction;
         break;
       }
     }
-
-    if (can_move)
-    {
-      car->cell_pos.cell_x += car->direction.x;
-      car->cell_pos.cell_y += car->direction.y;
-
-      // TODO: The offset is set to minus direction in order to place the car
-      //         in the centre of the cell it was previously in, we should
-      //         really be calculating the car's actual distance from the new
-      //         cell and setting the offset to minus that, and adjusting the
-      //         speed to compensate.
-      car->cell_pos.offset = -car->direction;
-    }
   }
+
+  return can_move;
 }
 
 
-u32
-cars_in_direct_neighbourhood(Maze *maze, Cars *cars, Cell *cell)
+void
+move_car(Maze *maze, Corridors *corridors, Car car, CellChunk **last_chunk)
 {
-  u32 result = 0;
+  u32 *skip_ticks = car_skip_ticks(car);
 
-  Car *test_car;
-  CarsIterator iter = {};
-  while ((test_car = cars_iterator(cars, &iter)))
+  if (*skip_ticks != 0)
+  {
+    // In transit through a corridor
+    --*skip_ticks;
+  }
+  else
   {
-    u32 test_x = test_car->cell_pos.cell_x;
-    u32 test_y = test_car->cell_pos.cell_y;
+    Cell *current_cell = get_car_cell(maze, car, last_chunk);
 
-    if (((test_x == cell->x - 1 || test_x == cell->x + 1) && test_y == cell->y) ||
-        ((test_y == cell->y - 1 || test_y == cell->y + 1) && test_x == cell->x))
+    CarDirection direction;
+    if (current_cell && get_car_move(current_cell, get_car_direction(car), &direction))
     {
-      ++result;
+      set_car_direction(car, direction);
+
+      u32 *cell_x = car_cell_x(car);
+      u32 *cell_y = car_cell_y(car);
+      u32 old_cell_x = *cell_x;
+      u32 old_cell_y = *cell_y;
+
+      vec2 direction_vector = CAR_DIRECTION_VECTORS[direction];
+      *cell_x += direction_vector.x;
+      *cell_y += direction_vector.y;
+
+      if (((*cell_x ^ old_cell_x) | (*cell_y ^ old_cell_y)) >> CELL_CHUNK_SIZE_BITS)
+      {
+        *car_cell(car) = 0;
+      }
+      else
+      {
+        // NOTE: The car only moves onto walkable cells, so the cell exists.
+        s32 cell_offset = (s32)direction_vector.x + (s32)direction_vector.y * (s32)CELL_CHUNK_SIZE;
+        *car_cell(car) = current_cell + cell_offset;
+      }
+
+      if (corridors)
+      {
+        CorridorRun *run = find_corridor_run(corridors, *car_cell_x(car), *car_cell_y(car), direction);
+        if (run)
+        {
+          *car_cell_x(car) = run->end_x;
+          *car_cell_y(car) = run->end_y;
+          set_car_direction(car, (CarDirection)run->end_direction);
+          *skip_ticks = run->length;
+          *car_cell(car) = 0;
+        }
+      }
     }
   }
+}
+
+
+u32
+cars_in_direct_neighbourhood(Cars *cars, u32 cell_x, u32 cell_y)
+{
+  // NOTE: Relies on the car occupancy being up to date for this tick.
+
+  CarOccupancy *occupancy = &cars->occupancy;
+
+  u32 result = (cars_on_cell(occupancy, cell_x - 1, cell_y) +
+                cars_on_cell(occupancy, cell_x + 1, cell_y) +
+                cars_on_cell(occupancy, cell_x, cell_y - 1) +
+                cars_on_cell(occupancy, cell_x, cell_y + 1));
 
   return result;
 }
 
 
 void
-car_cell_interactions(Memory *memory, GameState *game_state, u64 time_us, Maze *maze, Functions *functions, Cars *cars, Car *car)
+add_car_tick_event(CarsTickThread *thread, CarTickEventType type, Car car, CarDirection direction = CAR_STATIONARY)
+{
+  assert(thread->n_events < thread->events_size);
+  CarTickEvent *event = thread->events + thread->n_events++;
+  event->type = type;
+  event->car = car;
+  event->direction = direction;
+}
+
+
+// NOTE: Run on the sim threads, must only write to the car itself and
+//         the thread's CarsTickThread.
+void
+car_cell_interactions(Maze *maze, Functions *functions, Cars *cars, b32 loops_enabled, CarsTickThread *thread, Car car)
 {
   // TODO: Deal with race cars (conditions) ??
 
-  Cell *current_cell = get_cell(maze, car->cell_pos.cell_x, car->cell_pos.cell_y);
+  u32 cell_x = *car_cell_x(car);
+  u32 cell_y = *car_cell_y(car);
+  s32 *value = car_value(car);
+
+  Cell *current_cell = get_car_cell(maze, car, &thread->last_chunk);
 
   switch (current_cell->type)
   {
     case (CELL_NULL):
     {
       log(L_CarsSim, u8("Null"));
-      car->direction = STATIONARY;
+      set_car_direction(car, CAR_STATIONARY);
     } break;
 
     case (CELL_WALL):
     {
       log(L_CarsSim, u8("Wall"));
-      car->direction = STATIONARY;
+      set_car_direction(car, CAR_STATIONARY);
     } break;
 
     case (CELL_START):
@@ -147,18 +198,15 @@ car_cell_interactions(Memory *memory, GameState *game_state, u64 time_us, Maze *
     case (CELL_HOLE):
     {
       log(L_CarsSim, u8("Hole"));
-      car->dead = true;
+      set_car_flag(car, CAR_FLAG_DEAD, true);
     } break;
 
     case (CELL_SPLITTER):
     {
       log(L_CarsSim, u8("Splitter"));
 
-      Car *new_car = get_new_car(memory, cars);
-      init_car(game_state, time_us, new_car, car->cell_pos.cell_x, car->cell_pos.cell_y, RIGHT);
-      new_car->value = car->value;
-      new_car->direction = RIGHT;
-      car->direction = LEFT;
+      add_car_tick_event(thread, CAR_EVENT_SPLIT, car);
+      set_car_direction(car, CAR_LEFT);
     } break;
 
     case (CELL_FUNCTION):
@@ -167,7 +215,7 @@ car_cell_interactions(Memory *memory, GameState *game_state, u64 time_us, Maze *
 
       if (function->type == FUNCTION_NULL)
       {
-        log(L_CarsSim, u8("Function '%.2s' not defined, skipping."), current_cell->name);
+        log(L_CarsSim, u8("Function %u not defined, skipping."), (u32)current_cell->function_index);
       }
       else
       {
@@ -177,23 +225,23 @@ car_cell_interactions(Memory *memory, GameState *game_state, u64 time_us, Maze *
         {
           case (FUNCTION_ASSIGNMENT):
           {
-            car->value = function->value;
+            *value = function->value;
           } break;
           case (FUNCTION_INCREMENT):
           {
-            car->value += function->value;
+            *value += function->value;
           } break;
           case (FUNCTION_DECREMENT):
           {
-            car->value -= function->value;
+            *value -= function->value;
           } break;
           case (FUNCTION_MULTIPLY):
           {
-            car->value *= function->value;
+            *value *= function->value;
           } break;
           case (FUNCTION_DIVIDE):
           {
-            car->value /= function->value;
+            *value /= function->value;
           } break;
 
           case (FUNCTION_LESS):
@@ -207,49 +255,54 @@ car_cell_interactions(Memory *memory, GameState *game_state, u64 time_us, Maze *
             switch (function->type)
             {
               case (FUNCTION_LESS):
-                condition = car->value < function->conditional.value;
+                condition = *value < function->conditional.value;
                 break;
               case (FUNCTION_LESS_EQUAL):
-                condition = car->value <= function->conditional.value;
+                condition = *value <= function->conditional.value;
                 break;
               case (FUNCTION_EQUAL):
-                condition = car->value == function->conditional.value;
+                condition = *value == function->conditional.value;
                 break;
               case (FUNCTION_NOT_EQUAL):
-                condition = car->value != function->conditional.value;
+                condition = *value != function->conditional.value;
                 break;
               case (FUNCTION_GREATER_EQUAL):
-                condition = car->value >= function->conditional.value;
+                condition = *value >= function->conditional.value;
                 break;
               case (FUNCTION_GREATER):
-                condition = car->value > function->conditional.value;
+                condition = *value > function->conditional.value;
                 break;
               default: break;
             }
 
+            if (loops_enabled)
+            {
+              add_car_tick_event(thread, CAR_EVENT_LOOP, car, get_car_direction(car));
+            }
+
             if (condition)
             {
-              car->direction = function->conditional.true_direction;
+              set_car_direction(car, get_car_direction_from_vector(function->conditional.true_direction));
             }
             else
             {
               if (function->conditional.else_exists)
               {
-                car->direction = function->conditional.false_direction;
+                set_car_direction(car, get_car_direction_from_vector(function->conditional.false_direction));
               }
             }
           } break;
           default: break;
         }
 
-        log(L_CarsSim, u8("New car value: %d"), car->value);
+        log(L_CarsSim, u8("New car value: %d"), *value);
       }
     } break;
 
     case (CELL_ONCE):
     {
       log(L_CarsSim, u8("Once"));
-      car->updated_cell_type = CELL_WALL;
+      add_car_tick_event(thread, CAR_EVENT_ONCE, car);
     } break;
 
     case (CELL_UP_UNLESS_DETECT):
@@ -258,40 +311,22 @@ car_cell_interactions(Memory *memory, GameState *game_state, u64 time_us, Maze *
     case (CELL_RIGHT_UNLESS_DETECT):
     {
       log(L_CarsSim, u8("Unless Detect"));
-      // TODO: This might need optimising for large numbers of cars (We're looping through cars^2)
-      if (cars_in_direct_neighbourhood(maze, cars, current_cell) == 0)
+      if (cars_in_direct_neighbourhood(cars, cell_x, cell_y) == 0)
       {
-        switch (current_cell->type)
-        {
-          case (CELL_UP_UNLESS_DETECT):
-            car->direction = UP;
-            break;
-          case (CELL_DOWN_UNLESS_DETECT):
-            car->direction = DOWN;
-            break;
-          case (CELL_LEFT_UNLESS_DETECT):
-            car->direction = LEFT;
-            break;
-          case (CELL_RIGHT_UNLESS_DETECT):
-            car->direction = RIGHT;
-            break;
-          default:
-            break;
-        }
+        set_car_direction(car, get_car_direction_from_vector(get_direction_cell_direction(current_cell->type)));
       }
     } break;
 
     case (CELL_OUT):
     {
       log(L_CarsSim, u8("Output"));
-      printf("%d\n", car->value);
-      formatted_string(game_state->persistent_str, array_count(game_state->persistent_str), u8("%d"), car->value);
+      add_car_tick_event(thread, CAR_EVENT_OUTPUT, car);
     } break;
 
     case (CELL_INP):
     {
       log(L_CarsSim, u8("Input"));
-      init_car_input_box(memory, game_state, car->id, car->value, car->cell_pos);
+      add_car_tick_event(thread, CAR_EVENT_INPUT, car);
     } break;
 
     case (CELL_UP):
@@ -300,33 +335,39 @@ car_cell_interactions(Memory *memory, GameState *game_state, u64 time_us, Maze *
     case (CELL_RIGHT):
     {
       log(L_CarsSim, u8("Direction"));
-      car->direction = get_direction_cell_direction(current_cell->type);
+      set_car_direction(car, get_car_direction_from_vector(get_direction_cell_direction(current_cell->type)));
     } break;
 
     case (CELL_PAUSE):
     {
-      if (car->pause_left != 0)
+      u8 *pause_left = car_pause_left(car);
+      if (*pause_left != 0)
       {
-        --car->pause_left;
+        --*pause_left;
       }
 
-      if (car->pause_left == 0)
+      if (*pause_left == 0)
       {
-        if (car->unpause_direction == STATIONARY)
+        if (get_car_unpause_direction(car) == CAR_STATIONARY)
         {
           // Start Pause
-          car->pause_left = current_cell->pause;
-          car->unpause_direction = car->direction;
-          car->direction = STATIONARY;
+          *pause_left = current_cell->pause;
+          set_car_unpause_direction(car, get_car_direction(car));
+          set_car_direction(car, CAR_STATIONARY);
+
+          // NOTE: Held until the tick the pause ends on, see "Paused cars"
+          //         in cars-storage.h.
+          *car_skip_ticks(car) = max((u32)*pause_left, 1u);
+          *pause_left = min((u32)*pause_left, 1u);
         }
         else
         {
           // End Pause
-          car->direction = car->unpause_direction;
-          car->unpause_direction = STATIONARY;
+          set_car_direction(car, get_car_unpause_direction(car));
+          set_car_unpause_direction(car, CAR_STATIONARY);
         }
       }
-      log(L_CarsSim, u8("Pause: %d/%d"), car->pause_left, current_cell->pause);
+      log(L_CarsSim, u8("Pause: %d/%d"), *pause_left, current_cell->pause);
     } break;
 
     default:
@@ -337,155 +378,308 @@ car_cell_interactions(Memory *memory, GameState *game_state, u64 time_us, Maze *
 }
 
 
+// Give each thread a contiguous run of the block chain
 void
-perform_cars_sim_tick(Memory *memory, GameState *game_state, u64 time_us)
+split_cars_between_threads(CarsTick *tick, u32 max_threads)
 {
-  Cars *cars = &(game_state->cars);
-  Maze *maze = &(game_state->maze);
-  Functions *functions = &(game_state->functions);
-
-  // Car/cell interactions
+  u32 n_blocks = 0;
+  CarsBlock *block = tick->cars->first_block;
+  while (block)
+  {
+    ++n_blocks;
+    block = block->next_block;
+  }
 
-  CarsIterator iter = {};
-  Car *car;
+  u32 n_threads = min(max_threads, max(n_blocks / MIN_CARS_BLOCKS_PER_THREAD, (u32)1));
+  tick->n_threads = n_threads;
 
-  while ((car = cars_iterator(cars, &iter)))
+  block = tick->cars->first_block;
+  for (u32 thread_index = 0;
+       thread_index < n_threads;
+       ++thread_index)
   {
-    if (car->update_next_frame)
+    CarsTickThread *thread = tick->threads + thread_index;
+
+    u32 start = (n_blocks * thread_index) / n_threads;
+    u32 end = (n_blocks * (thread_index + 1)) / n_threads;
+
+    thread->first_block = block;
+    thread->n_blocks = end - start;
+    thread->n_events = 0;
+    thread->last_chunk = 0;
+
+    for (u32 block_index = start;
+         block_index < end;
+         ++block_index)
     {
-      car_cell_interactions(memory, game_state, time_us, maze, functions, cars, car);
+      block = block->next_block;
     }
   }
+}
 
-  while ((car = cars_iterator(cars, &iter)))
+
+void
+reserve_car_tick_events(Memory *memory, CarsTickThread *thread)
+{
+  u32 events_needed = thread->n_blocks * CARS_PER_BLOCK;
+  if (thread->events_size < events_needed)
   {
-    // NOTE: Necessary to do this loop separate from the previous
-    //         loop to set all new cells (including those in new
-    //         blocks - which would not have been iterated over in the
-    //         same loop) update_next_frame to true.
+    // NOTE: The old buffer is left in the arena, like the chunk hash.
+    u32 new_size = max(events_needed, 2 * thread->events_size);
+    log(L_CarsSim, u8("Growing car tick events buffer to %u"), new_size);
 
-    car->update_next_frame = true;
+    thread->events = push_structs(memory, CarTickEvent, new_size);
+    thread->events_size = new_size;
   }
+}
 
-  update_dead_cars(cars);
 
-  // Break loop here in case of multiple cars on the same cell
+void
+cars_interactions_job(u32 thread_index, void *data)
+{
+  CarsTick *tick = (CarsTick *)data;
+  CarsTickThread *thread = tick->threads + thread_index;
 
-  while ((car = cars_iterator(cars, &iter)))
+  CarsBlock *block = thread->first_block;
+  for (u32 block_index = 0;
+       block_index < thread->n_blocks;
+       ++block_index)
   {
-    if (car->updated_cell_type != CELL_NULL)
+    for (u32 car_index = 0;
+         car_index < block->next_free_in_block;
+         ++car_index)
     {
-      Cell *current_cell = get_cell(maze, car->cell_pos.cell_x, car->cell_pos.cell_y);
-      current_cell->type = car->updated_cell_type;
-      car->updated_cell_type = CELL_NULL;
+      Car car = {block, car_index};
+
+      if (*car_skip_ticks(car) != 0)
+      {
+        // In transit through a corridor or paused, there is nothing to
+        //   interact with
+      }
+      else if (get_car_flag(car, CAR_FLAG_UPDATE_NEXT_FRAME))
+      {
+        car_cell_interactions(tick->maze, tick->functions, tick->cars, tick->loops != 0, thread, car);
+      }
+      else
+      {
+        set_car_flag(car, CAR_FLAG_UPDATE_NEXT_FRAME, true);
+      }
     }
+
+    block = block->next_block;
   }
 }
 
 
 void
-move_cars(GameState *game_state)
+add_sim_input_request(Memory *memory, SimState *sim, u32 car_id)
 {
-  CarsIterator iter = {};
-  Car *car;
-  while ((car = cars_iterator(&game_state->cars, &iter)))
+  if (sim->n_input_car_ids == sim->input_car_ids_size)
   {
-    move_car(game_state, &game_state->maze, car);
+    // NOTE: The old buffer is left in the arena, like the chunk hash.
+    u32 new_size = sim->input_car_ids_size ? 2 * sim->input_car_ids_size : INITIAL_SIM_INPUT_REQUESTS_SIZE;
+    u32 *new_input_car_ids = push_structs(memory, u32, new_size);
+    memcpy(new_input_car_ids, sim->input_car_ids, sim->n_input_car_ids * sizeof(u32));
+
+    sim->input_car_ids = new_input_car_ids;
+    sim->input_car_ids_size = new_size;
   }
+
+  sim->input_car_ids[sim->n_input_car_ids++] = car_id;
 }
 
 
 void
-update_car_position(GameState *game_state, Car *car, u32 last_frame_dt)
+commit_car_tick_events(Memory *memory, SimState *sim, CarsTickThread *thread)
 {
-#if 1
-  r32 speed = (last_frame_dt / 1000000.0) * game_state->sim_ticks_per_s;
-  vec2 direction = -unit_vector(car->cell_pos.offset);
+  Cars *cars = &(sim->cars);
+  Maze *maze = &(sim->maze);
 
-  vec2 movement = direction * speed;
-
-  if (abs(car->cell_pos.offset.x) >= abs(movement.x))
+  for (u32 event_index = 0;
+       event_index < thread->n_events;
+       ++event_index)
   {
-    car->cell_pos.offset.x += movement.x;
+    CarTickEvent *event = thread->events + event_index;
+    Car car = event->car;
+    u32 cell_x = *car_cell_x(car);
+    u32 cell_y = *car_cell_y(car);
+    s32 value = *car_value(car);
+
+    switch (event->type)
+    {
+      case (CAR_EVENT_SPLIT):
+      {
+        Car new_car = get_new_car(memory, cars);
+        init_car(cars, new_car, cell_x, cell_y, CAR_RIGHT);
+        set_car_flag(new_car, CAR_FLAG_UPDATE_NEXT_FRAME, true);
+        add_car_to_occupancy(memory, &cars->occupancy, cell_x, cell_y);
+        *car_value(new_car) = value;
+        *car_count(new_car) = *car_count(car);
+      } break;
+
+      case (CAR_EVENT_ONCE):
+      {
+        // NOTE: Applied after all interactions in case of multiple cars
+        //         on the same cell.
+        Cell *current_cell = get_car_cell(maze, car, &thread->last_chunk);
+        set_cell_type(maze, current_cell, cell_x, cell_y, CELL_WALL, memory);
+      } break;
+
+      case (CAR_EVENT_OUTPUT):
+      {
+        if (sim->output_callback)
+        {
+          sim->output_callback(sim->output_user_data, value, *car_count(car));
+        }
+        else
+        {
+          for (u64 n = 0;
+               n < *car_count(car);
+               ++n)
+          {
+            printf("%d\n", value);
+          }
+        }
+        sim->n_outputs += *car_count(car);
+        sim->last_output = value;
+      } break;
+
+      case (CAR_EVENT_INPUT):
+      {
+        add_sim_input_request(memory, sim, *car_id(car));
+      } break;
+
+      case (CAR_EVENT_LOOP):
+      {
+        accelerate_car_loop(memory, &sim->loops, maze, &sim->functions, car, event->direction);
+      } break;
+    }
   }
-  else
+}
+
+
+void
+perform_cars_sim_tick(Memory *memory, SimState *sim)
+{
+  Cars *cars = &(sim->cars);
+  CarsTick *tick = &(sim->cars_tick);
+  SimThreads *sim_threads = &(sim->sim_threads);
+
+  tick->maze = &(sim->maze);
+  tick->functions = &(sim->functions);
+  tick->cars = cars;
+  tick->loops = sim->loops.enabled ? &(sim->loops) : 0;
+
+  sim->n_input_car_ids = 0;
+
+  rebuild_car_occupancy(memory, cars);
+
+  // Car/cell interactions
+
+  split_cars_between_threads(tick, get_n_sim_threads(sim_threads));
+  for (u32 thread_index = 0;
+       thread_index < tick->n_threads;
+       ++thread_index)
   {
-    car->cell_pos.offset.x = 0;
+    reserve_car_tick_events(memory, tick->threads + thread_index);
   }
 
-  if (abs(car->cell_pos.offset.y) >= abs(movement.y))
+  run_sim_threads(sim_threads, tick->n_threads, cars_interactions_job, tick);
+
+  for (u32 thread_index = 0;
+       thread_index < tick->n_threads;
+       ++thread_index)
   {
-    car->cell_pos.offset.y += movement.y;
+    commit_car_tick_events(memory, sim, tick->threads + thread_index);
   }
-  else
+
+  update_dead_cars(cars);
+
+  if (cars->merge_identical)
   {
-    car->cell_pos.offset.y = 0;
+    merge_identical_cars(memory, cars);
   }
-
-#else
-  car->cell_pos.offset = (vec2){0};
-#endif
 }
 
 
 void
-annimate_cars(GameState *game_state, u32 last_frame_dt)
+move_cars_job(u32 thread_index, void *data)
 {
-  CarsIterator iter = {};
-  Car *car;
-  while ((car = cars_iterator(&game_state->cars, &iter)))
+  CarsTick *tick = (CarsTick *)data;
+  CarsTickThread *thread = tick->threads + thread_index;
+
+  CarsBlock *block = thread->first_block;
+  for (u32 block_index = 0;
+       block_index < thread->n_blocks;
+       ++block_index)
   {
-    update_car_position(game_state, car, last_frame_dt);
+    for (u32 car_index = 0;
+         car_index < block->next_free_in_block;
+         ++car_index)
+    {
+      Car car = {block, car_index};
+      move_car(tick->maze, tick->corridors, car, &thread->last_chunk);
+    }
 
-    // Update this car's particle source to match the cars position.
-    car->particle_source->pos = car->cell_pos;
+    block = block->next_block;
   }
 }
 
 
 void
-draw_car(GameState *game_state, RenderWindow *render_window, Car *car, u64 time_us, vec4 colour = (vec4){1, 0.60, 0.13, 0.47})
+move_cars(SimState *sim)
 {
-  r32 car_radius = calc_car_radius(game_state->cell_margin);
-
-  vec2 pos = world_coord_to_render_window_coord(render_window, car->cell_pos);
-
-  glPushMatrix();
-    glTranslatef(pos.x, pos.y, 0);
-
-    glPushMatrix();
-      glScalef(car_radius, car_radius, 1);
-      glColor3f(colour.r, colour.g, colour.b);
+  CarsTick *tick = &(sim->cars_tick);
+  SimThreads *sim_threads = &(sim->sim_threads);
 
-      draw_circle();
-    glPopMatrix();
+  tick->maze = &(sim->maze);
+  tick->functions = &(sim->functions);
+  tick->cars = &(sim->cars);
+  tick->corridors = sim->corridors.enabled ? &(sim->corridors) : 0;
 
-    u32 max_len = 16;
-    u8 str[max_len];
-    r32 font_size = 0.15;
-
-    u32 chars = formatted_string(str, max_len, u8("%d"), car->value);
-    font_size /= chars;
-
-    // draw_string(&game_state->bitmaps.font, pos - 0.5*Vec2(chars, 1)*CHAR_SIZE*game_state->world_per_pixel*font_size, str, font_size);
-  glPopMatrix();
+  split_cars_between_threads(tick, get_n_sim_threads(sim_threads));
+  run_sim_threads(sim_threads, tick->n_threads, move_cars_job, tick);
 }
 
 
-void
-draw_cars(GameState *game_state, RenderWindow *render_window, Cars *cars, u64 time_us)
+// Jumps over ticks where every car is in transit through a corridor or
+//   loop, or paused, returns the number of ticks skipped.
+u32
+skip_idle_ticks(Cars *cars, u32 max_ticks = MAX_U32)
 {
-  // TODO: Loop through only relevant cars?
-  //       i.e.: spacial partitioning the storage.
-  //       Store the cars in the quad-tree?
-  CarsIterator iter = {};
-  Car *car;
-  while ((car = cars_iterator(cars, &iter)))
+  u32 ticks = 0;
+
+  if (cars->first_block)
   {
-#ifdef DEBUG_BLOCK_COLORS
-    draw_car(game_state, render_window, car, time_us, iter.cars_block->c);
-#else
-    draw_car(game_state, render_window, car, time_us);
-#endif
+    ticks = max_ticks;
+
+    for (CarsBlock *block = cars->first_block;
+         ticks && block;
+         block = block->next_block)
+    {
+      for (u32 car_index = 0;
+           ticks && car_index < block->next_free_in_block;
+           ++car_index)
+      {
+        ticks = min(ticks, block->skip_ticks[car_index]);
+      }
+    }
+
+    if (ticks)
+    {
+      for (CarsBlock *block = cars->first_block;
+           block;
+           block = block->next_block)
+      {
+        for (u32 car_index = 0;
+             car_index < block->next_free_in_block;
+             ++car_index)
+        {
+          block->skip_ticks[car_index] -= ticks;
+        }
+      }
+    }
   }
+
+  return ticks;
 }
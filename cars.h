@@ -1,2 +1,61 @@
-r32
-calc_car_radius(r32);
\ No newline at end of file
+// The cars tick is done in two phases:
+// - Interact: Blocks of cars are split between the sim threads, each
+//     car's cell interaction only writes to the car itself; anything
+//     touching shared state is recorded as a CarTickEvent in the
+//     thread's buffer.
+// - Commit: The event buffers are applied in thread order on the
+//     calling thread. Threads are given contiguous runs of the block
+//     chain, so this is the same order as the serial loop, and the
+//     output is identical whatever the number of threads.
+//
+// Waking the threads costs more than updating a few blocks, so each
+//   thread is given at least MIN_CARS_BLOCKS_PER_THREAD blocks.
+
+const u32 MIN_CARS_BLOCKS_PER_THREAD = 4;
+
+enum CarTickEventType
+{
+  CAR_EVENT_SPLIT,
+  CAR_EVENT_ONCE,
+  CAR_EVENT_OUTPUT,
+  CAR_EVENT_INPUT,
+  CAR_EVENT_LOOP
+};
+
+
+struct CarTickEvent
+{
+  CarTickEventType type;
+  Car car;
+
+  // CAR_EVENT_LOOP: The direction the car arrived on the cell in
+  CarDirection direction;
+};
+
+
+struct CarsTickThread
+{
+  CarsBlock *first_block;
+  u32 n_blocks;
+
+  // NOTE: Each car produces at most one event per tick, so the buffer
+  //         is sized to the number of cars given to the thread.
+  CarTickEvent *events;
+  u32 n_events;
+  u32 events_size;
+
+  CellChunk *last_chunk;
+};
+
+
+struct CarsTick
+{
+  Maze *maze;
+  Functions *functions;
+  Cars *cars;
+  Corridors *corridors;
+  Loops *loops;
+
+  u32 n_threads;
+  CarsTickThread threads[MAX_SIM_THREADS];
+};
\ No newline at end of file
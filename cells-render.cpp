@@ -0,0 +1,569 @@
+u32
+get_cell_ui_state_hash_slot(u32 x, u32 y, u32 hash_size)
+{
+  u32 result = ((x * 73856093) ^ (y * 19349663)) & (hash_size - 1);
+  return result;
+}
+
+
+void
+insert_cell_ui_state_into_hash(CellUIState *hash, u32 hash_size, CellUIState *state)
+{
+  u32 slot = get_cell_ui_state_hash_slot(state->x, state->y, hash_size);
+  while (hash[slot].used)
+  {
+    slot = (slot + 1) & (hash_size - 1);
+  }
+  hash[slot] = *state;
+}
+
+
+// Returns 0 if the cell has no state and memory is 0
+CellUIState *
+find_or_create_cell_ui_state(CellsUIState *states, u32 x, u32 y, Memory *memory = 0)
+{
+  CellUIState *result = 0;
+
+  if (states->hash)
+  {
+    u32 slot = get_cell_ui_state_hash_slot(x, y, states->hash_size);
+    while (states->hash[slot].used)
+    {
+      CellUIState *state = states->hash + slot;
+      if (state->x == x &&
+          state->y == y)
+      {
+        result = state;
+        break;
+      }
+      slot = (slot + 1) & (states->hash_size - 1);
+    }
+  }
+
+  if (!result && memory)
+  {
+    if (2 * (states->n_states + 1) > states->hash_size)
+    {
+      u32 new_hash_size = states->hash_size ? 2 * states->hash_size : INITIAL_CELLS_UI_STATE_HASH_SIZE;
+
+      // NOTE: The old table is left in the arena, like the chunk hash.
+      CellUIState *new_hash = push_structs(memory, CellUIState, new_hash_size);
+      zero_n(new_hash, CellUIState, new_hash_size);
+
+      for (u32 slot = 0;
+           slot < states->hash_size;
+           ++slot)
+      {
+        if (states->hash[slot].used)
+        {
+          insert_cell_ui_state_into_hash(new_hash, new_hash_size, states->hash + slot);
+        }
+      }
+
+      states->hash = new_hash;
+      states->hash_size = new_hash_size;
+    }
+
+    CellUIState new_state = {};
+    new_state.used = true;
+    new_state.x = x;
+    new_state.y = y;
+    insert_cell_ui_state_into_hash(states->hash, states->hash_size, &new_state);
+    ++states->n_states;
+
+    result = find_or_create_cell_ui_state(states, x, y);
+  }
+
+  return result;
+}
+
+
+void
+clear_cells_ui_state(CellsUIState *states)
+{
+  if (states->hash)
+  {
+    zero_n(states->hash, CellUIState, states->hash_size);
+  }
+  states->n_states = 0;
+}
+
+
+u32
+calc_cell_radius(GameState *game_state)
+{
+  return 1 - (game_state->cell_margin * 0.5);
+}
+
+
+void
+update_cells_ui_state(Memory *memory, GameState *game_state, Mouse *mouse, WorldSpace _mouse_pos, u64 time_us)
+{
+  vec2 cell_pos;
+  vec2 mouse_pos;
+  Rectangle cell_bounds = radius_rectangle(cell_pos, calc_cell_radius(game_state));
+
+  b32 hide_cell_menu = false;
+  b32 mouse_click = mouse->l_on_up;
+
+  if (in_rectangle(mouse_pos, cell_bounds))
+  {
+    Cell *cell_hovered_over = get_cell(&game_state->sim->maze, cell_pos.x, cell_pos.y);
+    CellUIState *hovered_ui_state = 0;
+    if (cell_hovered_over)
+    {
+      hovered_ui_state = find_or_create_cell_ui_state(&game_state->cells_ui_state, cell_pos.x, cell_pos.y, memory);
+    }
+
+    if (cell_hovered_over && cell_hovered_over->type != CELL_NULL)
+    {
+      hovered_ui_state->hovered_at_time = time_us;
+    }
+
+    if (mouse_click)
+    {
+      if (cell_hovered_over)
+      {
+        if (time_us >= hovered_ui_state->edit_mode_last_change + seconds_in_u(0.01))
+        {
+          hovered_ui_state->edit_mode_last_change = time_us;
+
+          open_cell_type_menu(game_state, cell_hovered_over, cell_pos.x, cell_pos.y, time_us);
+        }
+      }
+      else
+      {
+        hide_cell_menu = true;
+      }
+    }
+  }
+  else if (mouse_click)
+  {
+    hide_cell_menu = true;
+  }
+
+  if (hide_cell_menu)
+  {
+    game_state->ui.cell_type_menu.cell = 0;
+  }
+}
+
+
+void
+load_cell_bitmaps(CellBitmaps *cell_bitmaps)
+{
+  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_ENCLOSED], u8("cells/path-enclosed.bmp"));
+  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_SINGLE],   u8("cells/path-single.bmp"));
+  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_L],        u8("cells/path-l.bmp"));
+  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_STRAIGHT], u8("cells/path-straight.bmp"));
+  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_T],        u8("cells/path-t.bmp"));
+  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_CROSS],    u8("cells/path-cross.bmp"));
+  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_ENCLOSED], u8("cells/unwalkable-enclosed.bmp"));
+  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_SINGLE],   u8("cells/unwalkable-single.bmp"));
+  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_L],        u8("cells/unwalkable-l.bmp"));
+  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_STRAIGHT], u8("cells/unwalkable-straight.bmp"));
+  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_T],        u8("cells/unwalkable-t.bmp"));
+  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_CROSS],    u8("cells/unwalkable-cross.bmp"));
+
+  load_bitmap(&cell_bitmaps->arrow, u8("cells/arrow.bmp"));
+  load_bitmap(&cell_bitmaps->splitter, u8("cells/splitter.bmp"));
+}
+
+
+vec4
+get_cell_color(CellType type)
+{
+  vec4 result;
+  switch (type)
+  {
+    case CELL_NULL:     result = (vec4){1, 0.0, 0.0, 0.0};
+      break;
+    case CELL_START:    result = (vec4){1, 0.7, 0.3, 0.3};
+      break;
+    case CELL_PATH:     result = (vec4){1, 0.8, 0.8, 0.9};
+      break;
+    case CELL_WALL:     result = (vec4){1, 0.9, 0.8, 0.9};
+      break;
+    case CELL_HOLE:     result = (vec4){1, 0.0, 0.2, 0.7};
+      break;
+    case CELL_SPLITTER: result = (vec4){1, 0.7, 0.6, 0.0};
+      break;
+    case CELL_FUNCTION: result = (vec4){1, 0.7, 0.5, 0.3};
+      break;
+    case CELL_ONCE:     result = (vec4){1, 0.7, 0.4, 0.0};
+      break;
+    case CELL_UP_UNLESS_DETECT:     result = (vec4){1, 0.0, 0.1, 0.3};
+      break;
+    case CELL_DOWN_UNLESS_DETECT:   result = (vec4){1, 0.0, 0.1, 0.3};
+      break;
+    case CELL_LEFT_UNLESS_DETECT:   result = (vec4){1, 0.0, 0.1, 0.3};
+      break;
+    case CELL_RIGHT_UNLESS_DETECT:  result = (vec4){1, 0.0, 0.1, 0.3};
+      break;
+    case CELL_OUT:      result = (vec4){1, 0.0, 0.1, 0.3};
+      break;
+    case CELL_INP:      result = (vec4){1, 0.0, 0.1, 0.3};
+      break;
+    case CELL_UP:       result = (vec4){1, 0.0, 0.0, 0.0};
+      break;
+    case CELL_DOWN:     result = (vec4){1, 0.3, 0.0, 0.0};
+      break;
+    case CELL_LEFT:     result = (vec4){1, 0.0, 0.1, 0.3};
+      break;
+    case CELL_RIGHT:    result = (vec4){1, 0.3, 0.1, 0.3};
+      break;
+    case CELL_PAUSE:    result = (vec4){1, 0.3, 0.0, 0.7};
+      break;
+
+    default:
+      invalid_code_path;
+      break;
+  }
+
+  return result;
+}
+
+
+void
+calc_connected_cell_bitmap(Maze *maze, Cell *cell, CellBitmaps *cell_bitmaps, CellDisplay *cell_display_result)
+{
+  cell_display_result->rotate = 0;
+  CellConnectedState walkable = cell_walkable(cell);
+
+  CellConnectedState n[N_CELL_NEIGHBOURS];
+  for (u32 neighbour = 0;
+       neighbour < N_CELL_NEIGHBOURS;
+       ++neighbour)
+  {
+    n[neighbour] = get_neighbour_state(cell, (CellNeighbour)neighbour);
+  }
+
+  CellDisplayType cell_display_type;
+  if      (walkable == n[0] && walkable == n[1] &&
+           walkable == n[2] && walkable == n[3])
+  {
+    cell_display_type = DISP_TYPE_CROSS;
+    cell_display_result->rotate = 0;
+  }
+  else if (walkable == n[0] && walkable == n[1] &&
+           walkable == n[2] && walkable != n[3])
+  {
+    cell_display_type = DISP_TYPE_T;
+    cell_display_result->rotate = 90;
+  }
+  else if (walkable == n[0] && walkable == n[1] &&
+           walkable != n[2] && walkable == n[3])
+  {
+    cell_display_type = DISP_TYPE_T;
+    cell_display_result->rotate = 270;
+  }
+  else if (walkable == n[0] && walkable != n[1] &&
+           walkable == n[2] && walkable == n[3])
+  {
+    cell_display_type = DISP_TYPE_T;
+    cell_display_result->rotate = 0;
+  }
+  else if (walkable != n[0] && walkable == n[1] &&
+           walkable == n[2] && walkable == n[3])
+  {
+    cell_display_type = DISP_TYPE_T;
+    cell_display_result->rotate = 180;
+  }
+  else if (walkable == n[0] && walkable == n[1] &&
+           walkable != n[2] && walkable != n[3])
+  {
+    cell_display_type = DISP_TYPE_STRAIGHT;
+    cell_display_result->rotate = 0;
+  }
+  else if (walkable != n[0] && walkable != n[1] &&
+           walkable == n[2] && walkable == n[3])
+  {
+    cell_display_type = DISP_TYPE_STRAIGHT;
+    cell_display_result->rotate = 90;
+  }
+  else if (walkable == n[0] && walkable != n[1] &&
+           walkable == n[2] && walkable != n[3])
+  {
+    cell_display_type = DISP_TYPE_L;
+    cell_display_result->rotate = 0;
+  }
+  else if (walkable == n[0] && walkable != n[1] &&
+           walkable != n[2] && walkable == n[3])
+  {
+    cell_display_type = DISP_TYPE_L;
+    cell_display_result->rotate = 270;
+  }
+  else if (walkable != n[0] && walkable == n[1] &&
+           walkable == n[2] && walkable != n[3])
+  {
+    cell_display_type = DISP_TYPE_L;
+    cell_display_result->rotate = 90;
+  }
+  else if (walkable != n[0] && walkable == n[1] &&
+           walkable != n[2] && walkable == n[3])
+  {
+    cell_display_type = DISP_TYPE_L;
+    cell_display_result->rotate = 180;
+  }
+  else if (walkable == n[0] && walkable != n[1] &&
+           walkable != n[2] && walkable != n[3])
+  {
+    cell_display_type = DISP_TYPE_SINGLE;
+    cell_display_result->rotate = 0;
+  }
+  else if (walkable != n[0] && walkable == n[1] &&
+           walkable != n[2] && walkable != n[3])
+  {
+    cell_display_type = DISP_TYPE_SINGLE;
+    cell_display_result->rotate = 180;
+  }
+  else if (walkable != n[0] && walkable != n[1] &&
+           walkable == n[2] && walkable != n[3])
+  {
+    cell_display_type = DISP_TYPE_SINGLE;
+    cell_display_result->rotate = 90;
+  }
+  else if (walkable != n[0] && walkable != n[1] &&
+           walkable != n[2] && walkable == n[3])
+  {
+    cell_display_type = DISP_TYPE_SINGLE;
+    cell_display_result->rotate = 270;
+  }
+  else
+  {
+    cell_display_type = DISP_TYPE_ENCLOSED;
+  }
+
+  if (walkable == WALKABLE)
+  {
+    cell_display_result->bitmap = &cell_bitmaps->walkable[cell_display_type];
+  }
+  else
+  {
+    cell_display_result->bitmap = &cell_bitmaps->unwalkable[cell_display_type];
+  }
+}
+
+
+void
+get_overlay_display(CellType type, CellBitmaps *cell_bitmaps, CellDisplay *overlay_display_result)
+{
+  vec2 cell_direction = get_direction_cell_direction(type);
+  if (cell_direction != (vec2){0, 0})
+  {
+    overlay_display_result->bitmap = &cell_bitmaps->arrow;
+    overlay_display_result->rotate = angle_from_vector(cell_direction);
+
+    if (type == CELL_UP_UNLESS_DETECT ||
+        type == CELL_DOWN_UNLESS_DETECT ||
+        type == CELL_LEFT_UNLESS_DETECT ||
+        type == CELL_RIGHT_UNLESS_DETECT)
+    {
+      overlay_display_result->color = (vec4){1, 1, 0, 0};
+    }
+    else
+    {
+      overlay_display_result->color = (vec4){1, 1, 1, 1};
+    }
+  }
+  else if (type == CELL_SPLITTER)
+  {
+    overlay_display_result->color = (vec4){1, 1, 1, 1};
+    overlay_display_result->bitmap = &cell_bitmaps->splitter;
+  }
+  else
+  {
+    overlay_display_result->bitmap = 0;
+  }
+}
+
+
+void
+draw_cell(CellType type, vec2 normalised_world_pos, u32 cell_radius, b32 hovered, CellBitmaps *cell_bitmaps, CellDisplay *cell_display)
+{
+  Bitmap *cell_bitmap;
+  u32 rotate = 0;
+  if (cell_display)
+  {
+    cell_bitmap = cell_display->bitmap;
+    rotate = cell_display->rotate;
+  }
+  else
+  {
+    if (cell_walkable(type) == WALKABLE)
+    {
+      cell_bitmap = &cell_bitmaps->walkable[DISP_TYPE_CROSS];
+    }
+    else
+    {
+      cell_bitmap = &cell_bitmaps->unwalkable[DISP_TYPE_CROSS];
+    }
+  }
+
+  vec4 color = get_cell_color(type);
+  if (hovered)
+  {
+    color.r = min(color.r + 0.15, 1.0f);
+    color.g = min(color.g + 0.15, 1.0f);
+    color.b = min(color.b + 0.15, 1.0f);
+  }
+
+  CellDisplay overlay_display;
+  get_overlay_display(type, cell_bitmaps, &overlay_display);
+
+  glPushMatrix();
+    glTranslatef(normalised_world_pos.x, normalised_world_pos.y, 0);
+    glColor3f(color.r, color.g, color.b);
+
+    draw_box();
+  glPopMatrix();
+
+  normalised_world_pos -= cell_radius;
+  // BlitBitmapOptions opts;
+  // get_default_blit_bitmap_options(&opts);
+  // opts.scale = 2.0*cell_radius / (r32)cell_bitmap->file->width;
+  // opts.interpolation = false;
+
+  // opts.color_multiplier = color;
+  // opts.rotate = rotate;
+  // draw_bitmap(cell_bitmap, normalised_world_pos, &opts);
+
+  // if (overlay_display.bitmap)
+  // {
+  //   opts.rotate = overlay_display.rotate;
+  //   opts.color_multiplier = overlay_display.color;
+  //   opts.scale = 2.0*cell_radius / (r32)overlay_display.bitmap->file->width;
+  //   draw_bitmap(overlay_display.bitmap, normalised_world_pos, &opts);
+  // }
+}
+
+
+void
+draw_all_cells(GameState *game_state, RenderWindow *render_window, Maze *maze, u32 cell_radius, u64 time_us)
+{
+  // TODO: Only draw chunks which are on screen
+  CellsIterator iter = {};
+  Cell *cell;
+  while ((cell = cells_iterator(maze, &iter)))
+  {
+    vec2 normalised_cell_pos = world_coord_to_render_window_coord(render_window, iter.x, iter.y);
+
+    CellDisplay cell_display;
+    calc_connected_cell_bitmap(maze, cell, &game_state->cell_bitmaps, &cell_display);
+
+    CellUIState *ui_state = find_or_create_cell_ui_state(&game_state->cells_ui_state, iter.x, iter.y);
+    b32 hovered = ui_state && ui_state->hovered_at_time == time_us;
+
+    draw_cell(cell->type, normalised_cell_pos, cell_radius, hovered, &game_state->cell_bitmaps, &cell_display);
+  }
+}
+
+
+void
+draw_chunk_blocks(GameState *game_state, RenderWindow *render_window, Maze *maze)
+{
+  // Low-res cell drawing
+  // TODO: Do we still need this with OpenGL rendering?
+
+  CellChunk *chunk = maze->first_chunk;
+  while (chunk)
+  {
+    vec4 avg_color = {0, 0, 0, 0};
+    Rectangle normalised_bounds = {{0, 0}, {0, 0}};
+    for (u32 cell_index = 0;
+         cell_index < CELLS_PER_CHUNK;
+         ++cell_index)
+    {
+      if (!chunk_cell_exists(chunk, cell_index))
+      {
+        continue;
+      }
+
+      Cell *cell = chunk->cells + cell_index;
+      avg_color += get_cell_color(cell->type);
+
+      vec2 normalised_pos = world_coord_to_render_window_coord(render_window, get_chunk_cell_x(chunk, cell_index), get_chunk_cell_y(chunk, cell_index));
+
+      if (normalised_pos.x < normalised_bounds.start.x)
+      {
+        normalised_bounds.start.x = normalised_pos.x;
+      }
+      if (normalised_pos.y < normalised_bounds.start.y)
+      {
+        normalised_bounds.start.y = normalised_pos.y;
+      }
+      if (normalised_pos.x > normalised_bounds.end.x)
+      {
+        normalised_bounds.end.x = normalised_pos.x;
+      }
+      if (normalised_pos.y > normalised_bounds.end.y)
+      {
+        normalised_bounds.end.y = normalised_pos.y;
+      }
+    }
+    avg_color /= chunk->n_cells;
+
+    // TODO: Update this to work with OpenGL
+    b32 on_screen = true;
+
+    if (on_screen)
+    {
+      draw_box(normalised_bounds, avg_color);
+    }
+
+    chunk = chunk->next_chunk;
+  }
+}
+
+
+void
+draw_cells(GameState *game_state, RenderWindow *render_window, Maze *maze, u64 time_us)
+{
+  // TODO:
+  // if (render_basis->scale >= 0.01)
+  if (1)
+  {
+    u32 cell_radius = calc_cell_radius(game_state);
+
+    draw_all_cells(game_state, render_window, maze, cell_radius, time_us);
+
+    // Animate highlight for cell which is currently being edited
+    if (game_state->ui.cell_type_menu.cell)
+    {
+      if (game_state->ui.cell_type_menu.highlighted_cell_annimation_offset.x == -1)
+      {
+        // No animation if there was no previously highlighted cell
+        game_state->ui.cell_type_menu.highlighted_cell_annimation_offset = (vec2){0, 0};
+      }
+      else
+      {
+        // TODO: Proper animation
+        game_state->ui.cell_type_menu.highlighted_cell_annimation_offset *= 0.3;
+      }
+
+      WorldSpace highlight_world_pos = {
+        game_state->ui.cell_type_menu.cell_x,
+        game_state->ui.cell_type_menu.cell_y,
+        game_state->ui.cell_type_menu.highlighted_cell_annimation_offset
+      };
+
+      re_form_world_coord(&highlight_world_pos);
+      vec2 normalised_highlight_pos = world_coord_to_render_window_coord(render_window, highlight_world_pos);
+
+      glPushMatrix();
+        glColor3f(.9, .1, .2); // TODO: Alpha: 0.3
+        glTranslatef(normalised_highlight_pos.x, normalised_highlight_pos.y, 0);
+
+        draw_box_outline(Vec2(cell_radius, cell_radius), 0.3);
+      glPopMatrix();
+    }
+    else
+    {
+      game_state->ui.cell_type_menu.highlighted_cell_annimation_offset = (vec2){-1, -1};
+    }
+  }
+  else
+  {
+    draw_chunk_blocks(game_state, render_window, maze);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+enum CellDisplayType
+{
+  DISP_TYPE_ENCLOSED,
+  DISP_TYPE_SINGLE,
+  DISP_TYPE_L,
+  DISP_TYPE_STRAIGHT,
+  DISP_TYPE_T,
+  DISP_TYPE_CROSS,
+
+  N_DISP_TYPES
+};
+
+
+struct CellBitmaps
+{
+  Bitmap walkable[N_DISP_TYPES];
+  Bitmap unwalkable[N_DISP_TYPES];
+  Bitmap arrow;
+  Bitmap splitter;
+};
+
+
+// The GUI's state for cells, kept out of the sim's cells. There is only
+//   an entry for cells which have been hovered over or edited, found
+//   through an open-addressing hash table keyed by the cell's position.
+struct CellUIState
+{
+  b32 used;
+  u32 x;
+  u32 y;
+
+  u64 hovered_at_time;
+
+  u64 edit_mode_last_change;
+};
+
+
+const u32 INITIAL_CELLS_UI_STATE_HASH_SIZE = 1024;  // Must be a power of two
+struct CellsUIState
+{
+  CellUIState *hash;
+  u32 hash_size;
+  u32 n_states;
+};
+
+
+struct CellDisplay
+{
+  Bitmap *bitmap;
+  Bitmap *bitmap_overlay;
+  u32 rotate;
+  vec4 color;
+};
+
+
+void
+draw_cell(CellType type, vec2 world_pos, u32 cell_radius, b32 hovered, CellBitmaps *cell_bitmaps, CellDisplay *cell_display = 0);
\ No newline at end of file
@@ -0,0 +1,444 @@
+// Benchmark of the chunked cell storage against the QuadTree + cache
+//   hash storage it replaced, and of the chunks in Morton order.
+//
+// Usage: cells-storage-benchmark [n_cells ...]
+//   Defaults to 10^6 and 10^7 cells, 10^8 cells needs ~10GB of memory.
+
+
+// NOTE: Built on the library, so the storage is benchmarked without SDL
+//         or OpenGL, like parser-benchmark.
+#include "libmazesim.cpp"
+
+
+//
+// The QuadTree storage, as it was before the chunked storage.
+//
+
+// The cell as it was, with its position and GUI state in it
+struct QuadTreeCell
+{
+  u32 x;
+  u32 y;
+  enum CellType type;
+  u8 name[2];
+  u8 neighbour_states;
+  u8 is_corridor;
+  u32 opengl_instance_position;
+  u64 hovered_at_time;
+  u64 edit_mode_last_change;
+  union
+  {
+    u32 pause;
+    u32 function_index;
+  };
+};
+
+
+const u32 QUAD_STORE_N = 16;
+struct QuadTree
+{
+  Rectangle bounds;
+
+  u32 used;
+  QuadTreeCell cells[QUAD_STORE_N];
+
+  QuadTree *top_right;
+  QuadTree *top_left;
+  QuadTree *bottom_right;
+  QuadTree *bottom_left;
+};
+
+
+const u32 CELL_CACHE_SIZE = 512;
+struct QuadTreeMaze
+{
+  QuadTreeCell *cache_hash[CELL_CACHE_SIZE];
+
+  QuadTree tree;
+};
+
+
+QuadTreeCell *
+get_cell_from_quad(QuadTree *tree, u32 x, u32 y, b32 create_new = false)
+{
+  QuadTreeCell *cell = 0;
+  for (u32 cell_index = 0;
+       cell_index < tree->used;
+       ++cell_index)
+  {
+    QuadTreeCell *test_cell = tree->cells + cell_index;
+    if ((test_cell->x == x) &&
+        (test_cell->y == y))
+    {
+      cell = test_cell;
+      break;
+    }
+  }
+  if (create_new && !cell && tree->used != QUAD_STORE_N)
+  {
+    cell = tree->cells + tree->used++;
+    zero(cell, QuadTreeCell);
+    cell->x = x;
+    cell->y = y;
+  }
+  return cell;
+}
+
+
+QuadTree *
+create_tree(Memory *memory, Rectangle bounds)
+{
+  QuadTree * tree = 0;
+  if (memory)
+  {
+    tree = push_struct(memory, QuadTree);
+    tree->bounds = bounds;
+  }
+  return tree;
+}
+
+
+QuadTreeCell **
+get_cell_from_hash(QuadTreeMaze *maze, u32 x, u32 y)
+{
+  u32 hash = (7 * x + 13 * y) % CELL_CACHE_SIZE;
+  QuadTreeCell **hash_slot = maze->cache_hash + hash;
+
+  return hash_slot;
+}
+
+
+QuadTreeCell *
+quadtree_find_or_create_cell(QuadTreeMaze *maze, u32 x, u32 y, Memory *memory = 0)
+{
+  QuadTree * tree = &(maze->tree);
+
+  QuadTreeCell *cell = 0;
+  QuadTreeCell *hash_cell = *get_cell_from_hash(maze, x, y);
+
+  if (hash_cell && hash_cell->x == x && hash_cell->y == y)
+  {
+    cell = hash_cell;
+  }
+  else
+  {
+    while (tree && !(cell = get_cell_from_quad(tree, x, y, memory != 0)))
+    {
+      Rectangle top_right_bounds    = get_top_right(tree->bounds);
+      Rectangle top_left_bounds     = get_top_left(tree->bounds);
+      Rectangle bottom_right_bounds = get_bottom_right(tree->bounds);
+      Rectangle bottom_left_bounds  = get_bottom_left(tree->bounds);
+
+      if (in_rectangle(Vec2(x, y), top_right_bounds))
+      {
+        if (!tree->top_right)
+        {
+          tree->top_right = create_tree(memory, top_right_bounds);
+        }
+        tree = tree->top_right;
+      }
+      else if (in_rectangle(Vec2(x, y), top_left_bounds))
+      {
+        if (!tree->top_left)
+        {
+          tree->top_left = create_tree(memory, top_left_bounds);
+        }
+        tree = tree->top_left;
+      }
+      else if (in_rectangle(Vec2(x, y), bottom_right_bounds))
+      {
+        if (!tree->bottom_right)
+        {
+          tree->bottom_right = create_tree(memory, bottom_right_bounds);
+        }
+        tree = tree->bottom_right;
+      }
+      else if (in_rectangle(Vec2(x, y), bottom_left_bounds))
+      {
+        if (!tree->bottom_left)
+        {
+          tree->bottom_left = create_tree(memory, bottom_left_bounds);
+        }
+        tree = tree->bottom_left;
+      }
+      else
+      {
+        break;
+      }
+    }
+
+    if (cell)
+    {
+      for (u32 cell_index = 0;
+           cell_index < tree->used;
+           ++cell_index)
+      {
+        QuadTreeCell *cell_to_cache = tree->cells + cell_index;
+        QuadTreeCell **hash_slot = get_cell_from_hash(maze, cell->x, cell->y);
+        *hash_slot = cell_to_cache;
+      }
+    }
+  }
+
+  return cell;
+}
+
+
+// A pass over every cell, as the recursive walks over the QuadTree did
+u64
+quadtree_sum_cell_types(QuadTree *tree)
+{
+  u64 result = 0;
+
+  if (tree)
+  {
+    for (u32 cell_index = 0;
+         cell_index < tree->used;
+         ++cell_index)
+    {
+      result += tree->cells[cell_index].type;
+    }
+
+    result += quadtree_sum_cell_types(tree->top_right);
+    result += quadtree_sum_cell_types(tree->top_left);
+    result += quadtree_sum_cell_types(tree->bottom_right);
+    result += quadtree_sum_cell_types(tree->bottom_left);
+  }
+
+  return result;
+}
+
+
+//
+// Benchmark
+//
+
+enum BenchmarkStorage
+{
+  STORAGE_QUADTREE,
+  STORAGE_CHUNKED,
+  STORAGE_MORTON,
+
+  N_BENCHMARK_STORAGES
+};
+
+const u8 *STORAGE_NAMES[] = {
+  u8("QuadTree"),
+  u8("Chunked"),
+  u8("Morton")
+};
+
+
+struct BenchmarkResult
+{
+  r64 insert_ns_per_cell;
+  r64 neighbour_ns_per_lookup;
+  r64 random_ns_per_lookup;
+  r64 pass_ns_per_cell;
+  r64 megabytes_used;
+  u64 checksum;
+};
+
+
+u32
+xorshift(u32 *state)
+{
+  u32 x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+
+void
+benchmark_set_cell_type(BenchmarkStorage storage, void *maze, u32 x, u32 y, CellType type, Memory *memory)
+{
+  if (storage == STORAGE_QUADTREE)
+  {
+    quadtree_find_or_create_cell((QuadTreeMaze *)maze, x, y, memory)->type = type;
+  }
+  else
+  {
+    find_or_create_cell((Maze *)maze, x, y, memory)->type = type;
+  }
+}
+
+
+// Returns 0 if there is no cell
+u32
+benchmark_get_cell_type(BenchmarkStorage storage, void *maze, u32 x, u32 y)
+{
+  u32 result = 0;
+  if (storage == STORAGE_QUADTREE)
+  {
+    QuadTreeCell *cell = quadtree_find_or_create_cell((QuadTreeMaze *)maze, x, y);
+    result = cell ? cell->type : 0;
+  }
+  else
+  {
+    Cell *cell = find_or_create_cell((Maze *)maze, x, y);
+    result = cell ? cell->type : 0;
+  }
+  return result;
+}
+
+
+b32
+run_benchmark(BenchmarkStorage storage, u64 n_cells, BenchmarkResult *result)
+{
+  b32 success = true;
+
+  u32 side = (u32)sqrt((r64)n_cells);
+  n_cells = (u64)side * side;
+
+  Memory memory;
+  memory.total = 2 * n_cells * (storage == STORAGE_QUADTREE ? sizeof(QuadTreeCell) : sizeof(Cell)) + megabytes_to_bytes(64);
+  memory.used = 0;
+  memory.memory = (u8 *)malloc(memory.total);
+
+  if (!memory.memory)
+  {
+    printf("Couldn't allocate %lu MB for %s storage, skipping.\n", bytes_to_megabytes(memory.total), STORAGE_NAMES[storage]);
+    success = false;
+  }
+  else
+  {
+    void *maze;
+    if (storage == STORAGE_QUADTREE)
+    {
+      QuadTreeMaze *quadtree_maze = push_struct(&memory, QuadTreeMaze);
+      zero(quadtree_maze, QuadTreeMaze);
+      quadtree_maze->tree.bounds = (Rectangle){(vec2){0, 0}, (vec2){MAX_MAZE_SIZE, MAX_MAZE_SIZE}};
+      maze = quadtree_maze;
+    }
+    else
+    {
+      Maze *chunked_maze = push_struct(&memory, Maze);
+      zero(chunked_maze, Maze);
+      maze = chunked_maze;
+    }
+
+    u64 checksum = 0;
+
+    // Insert every cell in file order, as parse() does
+    u64 start = get_us();
+    for (u32 y = 0; y < side; ++y)
+    {
+      for (u32 x = 0; x < side; ++x)
+      {
+        benchmark_set_cell_type(storage, maze, x, y, (CellType)(1 + (x ^ y) % (N_CELL_TYPES - 1)), &memory);
+      }
+    }
+    if (storage == STORAGE_MORTON)
+    {
+      order_maze_chunks((Maze *)maze, &memory);
+    }
+    u64 end = get_us();
+    result->insert_ns_per_cell = 1000.0 * (end - start) / n_cells;
+
+    // Look up the neighbours of every cell, as move_car() and
+    //   calc_connected_cell_bitmap() do
+    start = get_us();
+    for (u32 y = 0; y < side; ++y)
+    {
+      for (u32 x = 0; x < side; ++x)
+      {
+        checksum += benchmark_get_cell_type(storage, maze, x, y-1);
+        checksum += benchmark_get_cell_type(storage, maze, x, y+1);
+        checksum += benchmark_get_cell_type(storage, maze, x+1, y);
+        checksum += benchmark_get_cell_type(storage, maze, x-1, y);
+      }
+    }
+    end = get_us();
+    result->neighbour_ns_per_lookup = 1000.0 * (end - start) / (4 * n_cells);
+
+    // Random lookups
+    u32 n_random_lookups = 4000000;
+    u32 random_state = 2463534242;
+    start = get_us();
+    for (u32 i = 0; i < n_random_lookups; ++i)
+    {
+      u32 x = xorshift(&random_state) % side;
+      u32 y = xorshift(&random_state) % side;
+      checksum += benchmark_get_cell_type(storage, maze, x, y);
+    }
+    end = get_us();
+    result->random_ns_per_lookup = 1000.0 * (end - start) / n_random_lookups;
+
+    // Pass over every cell, as perform_cells_sim_tick() and the
+    //   serializer do
+    start = get_us();
+    if (storage == STORAGE_QUADTREE)
+    {
+      checksum += quadtree_sum_cell_types(&((QuadTreeMaze *)maze)->tree);
+    }
+    else
+    {
+      CellsIterator iter = {};
+      Cell *cell;
+      while ((cell = cells_iterator((Maze *)maze, &iter)))
+      {
+        checksum += cell->type;
+      }
+    }
+    end = get_us();
+    result->pass_ns_per_cell = 1000.0 * (end - start) / n_cells;
+
+    result->megabytes_used = memory.used / (r64)megabytes_to_bytes(1);
+    result->checksum = checksum;
+
+    free(memory.memory);
+  }
+
+  return success;
+}
+
+
+int
+main(int argc, char const *argv[])
+{
+  register_game_logging_channels(GAME_LOGGING_CHANNEL_DEFINITIONS);
+
+  u64 default_sizes[] = {1000000, 10000000};
+
+  u32 n_sizes = argc > 1 ? argc - 1 : array_count(default_sizes);
+
+  printf("%12s  %-9s %12s %18s %16s %14s %10s\n", "cells", "storage", "insert ns", "neighbour ns/get", "random ns/get", "pass ns/cell", "MB");
+
+  for (u32 size_index = 0;
+       size_index < n_sizes;
+       ++size_index)
+  {
+    u64 n_cells = argc > 1 ? strtoull(argv[size_index + 1], 0, 10) : default_sizes[size_index];
+
+    BenchmarkResult results[N_BENCHMARK_STORAGES];
+    b32 ran[N_BENCHMARK_STORAGES];
+    for (u32 storage = STORAGE_QUADTREE;
+         storage < N_BENCHMARK_STORAGES;
+         ++storage)
+    {
+      ran[storage] = run_benchmark((BenchmarkStorage)storage, n_cells, results + storage);
+      if (ran[storage])
+      {
+        BenchmarkResult *r = results + storage;
+        printf("%12lu  %-9s %12.1f %18.1f %16.1f %14.1f %10.1f\n", n_cells, STORAGE_NAMES[storage],
+               r->insert_ns_per_cell, r->neighbour_ns_per_lookup, r->random_ns_per_lookup, r->pass_ns_per_cell, r->megabytes_used);
+      }
+    }
+
+    for (u32 storage = STORAGE_CHUNKED;
+         storage < N_BENCHMARK_STORAGES;
+         ++storage)
+    {
+      if (ran[STORAGE_QUADTREE] && ran[storage] &&
+          results[STORAGE_QUADTREE].checksum != results[storage].checksum)
+      {
+        printf("Error: Storage checksums differ.\n");
+      }
+    }
+  }
+
+  return 0;
+}
\ No newline at end of file
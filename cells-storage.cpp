@@ -1,155 +1,980 @@
-Cell *
-get_cell_from_quad(QuadTree *tree, u32 x, u32 y, b32 create_new = false)
+u32
+get_chunk_hash_slot(u32 chunk_x, u32 chunk_y, u32 hash_size)
 {
-  Cell *cell = 0;
-  for (u32 cell_index = 0;
-       cell_index < tree->used;
-       ++cell_index)
+  u32 result = ((chunk_x * 73856093) ^ (chunk_y * 19349663)) & (hash_size - 1);
+  return result;
+}
+
+
+// For the tables keyed by a cell and a direction, i.e. the corridor runs
+//   and loop attempts
+u32
+get_cell_direction_hash_slot(u32 x, u32 y, u8 direction, u32 hash_size)
+{
+  u32 result = ((x * 73856093) ^ (y * 19349663) ^ (direction * 83492791)) & (hash_size - 1);
+  return result;
+}
+
+
+void
+insert_chunk_into_hash(CellChunk **chunk_hash, u32 hash_size, CellChunk *chunk)
+{
+  u32 slot = get_chunk_hash_slot(chunk->chunk_x, chunk->chunk_y, hash_size);
+  while (chunk_hash[slot])
+  {
+    slot = (slot + 1) & (hash_size - 1);
+  }
+  chunk_hash[slot] = chunk;
+}
+
+
+void
+grow_chunk_hash(Maze *maze, Memory *memory)
+{
+  u32 new_hash_size = maze->chunk_hash_size ? 2 * maze->chunk_hash_size : INITIAL_CHUNK_HASH_SIZE;
+  log(L_CellsStorage, u8("Growing chunk hash to %u slots"), new_hash_size);
+
+  // NOTE: The old table is left in the arena, the total wasted is less
+  //         than the size of the final table.
+  CellChunk **new_chunk_hash = push_structs(memory, CellChunk *, new_hash_size);
+  zero_n(new_chunk_hash, CellChunk *, new_hash_size);
+
+  CellChunk *chunk = maze->first_chunk;
+  while (chunk)
   {
-    Cell *test_cell = tree->cells + cell_index;
-    if ((test_cell->x == x) &&
-        (test_cell->y == y))
+    insert_chunk_into_hash(new_chunk_hash, new_hash_size, chunk);
+    chunk = chunk->next_chunk;
+  }
+
+  maze->chunk_hash = new_chunk_hash;
+  maze->chunk_hash_size = new_hash_size;
+}
+
+
+CellChunk *
+find_chunk_in_hash(Maze *maze, u32 chunk_x, u32 chunk_y)
+{
+  CellChunk *chunk = 0;
+
+  if (maze->chunk_hash)
+  {
+    u32 slot = get_chunk_hash_slot(chunk_x, chunk_y, maze->chunk_hash_size);
+    while (maze->chunk_hash[slot])
     {
-      cell = test_cell;
-      break;
+      CellChunk *test_chunk = maze->chunk_hash[slot];
+      if (test_chunk->chunk_x == chunk_x &&
+          test_chunk->chunk_y == chunk_y)
+      {
+        chunk = test_chunk;
+        break;
+      }
+      slot = (slot + 1) & (maze->chunk_hash_size - 1);
     }
   }
-  if (create_new && !cell && tree->used != QUAD_STORE_N)
+
+  return chunk;
+}
+
+
+CellChunk *
+create_chunk(Maze *maze, u32 chunk_x, u32 chunk_y, Memory *memory)
+{
+  CellChunk *chunk = 0;
+
+  if (2 * (maze->n_chunks + 1) > maze->chunk_hash_size)
   {
-    cell = tree->cells + tree->used++;
-    zero(cell, Cell);
-    cell->x = x;
-    cell->y = y;
+    grow_chunk_hash(maze, memory);
   }
-  return cell;
+
+  if (maze->free_chain)
+  {
+    chunk = maze->free_chain;
+    maze->free_chain = chunk->next_chunk;
+    log(L_CellsStorage, u8("Getting cell chunk from free chain"));
+  }
+  else
+  {
+    chunk = push_struct(memory, CellChunk);
+    log(L_CellsStorage, u8("Allocating new cell chunk"));
+  }
+
+  zero(chunk, CellChunk);
+  chunk->chunk_x = chunk_x;
+  chunk->chunk_y = chunk_y;
+
+  chunk->next_chunk = maze->first_chunk;
+  maze->first_chunk = chunk;
+  ++maze->n_chunks;
+
+  insert_chunk_into_hash(maze->chunk_hash, maze->chunk_hash_size, chunk);
+
+  return chunk;
 }
 
 
-QuadTree *
-create_tree(Memory *memory, Rectangle bounds)
+// Gives the range of the row's runs, returns false if the row has none
+b32
+get_row_runs_range(RowRuns *row_runs, u32 y, u64 *first_run, u64 *end_run)
 {
-  QuadTree * tree = 0;
-  if (memory)
+  b32 result = false;
+
+  if (y < row_runs->n_rows)
   {
-    tree = push_struct(memory, QuadTree);
-    tree->bounds = bounds;
+    *first_run = row_runs->row_first_run[y];
+    *end_run = y + 1 < row_runs->n_rows ? row_runs->row_first_run[y + 1] : row_runs->n_runs;
+    result = *first_run != *end_run;
   }
-  return tree;
+
+  return result;
 }
 
 
-Cell **
-get_cell_from_hash(Maze *maze, u32 x, u32 y)
+// The index of the first of the row's runs which ends after x, or the
+//   end of the row's runs
+u64
+find_row_run_index(RowRuns *row_runs, u64 first_run, u64 end_run, u32 x)
 {
-  u32 hash = (7 * x + 13 * y) % CELL_CACHE_SIZE;
-  Cell **hash_slot = maze->cache_hash + hash;
+  while (first_run < end_run)
+  {
+    u64 middle_run = first_run + (end_run - first_run) / 2;
+    CellRun *run = row_runs->runs + middle_run;
+    if ((u64)run->start_x + run->length > x)
+    {
+      end_run = middle_run;
+    }
+    else
+    {
+      first_run = middle_run + 1;
+    }
+  }
 
-  return hash_slot;
+  return first_run;
 }
 
 
-Cell *
-find_or_create_cell(Maze *maze, u32 x, u32 y, Memory *memory = 0)
+CellRun *
+find_cell_run(RowRuns *row_runs, u32 x, u32 y)
 {
-  QuadTree * tree = &(maze->tree);
+  CellRun *result = 0;
 
-  Cell *cell = 0;
-  Cell *hash_cell = *get_cell_from_hash(maze, x, y);
+  u64 first_run;
+  u64 end_run;
+  if (get_row_runs_range(row_runs, y, &first_run, &end_run))
+  {
+    u64 run_index = find_row_run_index(row_runs, first_run, end_run, x);
+    if (run_index < end_run &&
+        row_runs->runs[run_index].start_x <= x)
+    {
+      result = row_runs->runs + run_index;
+    }
+  }
 
-  if (hash_cell && hash_cell->x == x && hash_cell->y == y)
+  return result;
+}
+
+
+// Fills in the cell from the runs, ignoring any chunk built over it.
+//   Returns false if there is no cell there.
+b32
+get_row_runs_cell(RowRuns *row_runs, u32 x, u32 y, Cell *result)
+{
+  CellRun *run = find_cell_run(row_runs, x, y);
+  if (run)
   {
-    log(L_CellsStorage, u8("Got cell from hash"));
-    cell = hash_cell;
+    zero(result, Cell);
+    result->type = (CellType)run->type;
+    result->pause = run->value;
   }
-  else
+
+  return run != 0;
+}
+
+
+CellType
+get_row_runs_cell_type(RowRuns *row_runs, u32 x, u32 y)
+{
+  CellRun *run = find_cell_run(row_runs, x, y);
+  CellType result = run ? (CellType)run->type : CELL_NULL;
+  return result;
+}
+
+
+// Returns 0 if none of the runs are in the chunk.
+//
+// NOTE: The maze's stats already count the runs' cells.
+CellChunk *
+build_chunk_from_runs(Maze *maze, u32 chunk_x, u32 chunk_y)
+{
+  CellChunk *chunk = 0;
+  RowRuns *row_runs = maze->row_runs;
+
+  u32 min_x = chunk_x << CELL_CHUNK_SIZE_BITS;
+  u32 max_x = min_x + CELL_CHUNK_MASK;
+
+  for (u32 chunk_cell_y = 0;
+       chunk_cell_y < CELL_CHUNK_SIZE;
+       ++chunk_cell_y)
   {
-    while (tree && !(cell = get_cell_from_quad(tree, x, y, memory != 0)))
+    u32 y = (chunk_y << CELL_CHUNK_SIZE_BITS) + chunk_cell_y;
+
+    u64 first_run;
+    u64 end_run;
+    if (!get_row_runs_range(row_runs, y, &first_run, &end_run))
     {
-      Rectangle top_right_bounds    = get_top_right(tree->bounds);
-      Rectangle top_left_bounds     = get_top_left(tree->bounds);
-      Rectangle bottom_right_bounds = get_bottom_right(tree->bounds);
-      Rectangle bottom_left_bounds  = get_bottom_left(tree->bounds);
+      continue;
+    }
 
-      if (in_rectangle(Vec2(x, y), top_right_bounds))
+    for (u64 run_index = find_row_run_index(row_runs, first_run, end_run, min_x);
+         run_index < end_run && row_runs->runs[run_index].start_x <= max_x;
+         ++run_index)
+    {
+      CellRun *run = row_runs->runs + run_index;
+
+      if (!chunk)
       {
-        if (!tree->top_right)
-        {
-          tree->top_right = create_tree(memory, top_right_bounds);
-        }
-        tree = tree->top_right;
+        chunk = create_chunk(maze, chunk_x, chunk_y, row_runs->memory);
       }
-      else if (in_rectangle(Vec2(x, y), top_left_bounds))
+
+      u32 run_min_x = max(run->start_x, min_x);
+      u32 run_max_x = (u32)min((u64)run->start_x + run->length - 1, (u64)max_x);
+      for (u32 x = run_min_x;
+           x <= run_max_x;
+           ++x)
       {
-        if (!tree->top_left)
-        {
-          tree->top_left = create_tree(memory, top_left_bounds);
-        }
-        tree = tree->top_left;
+        u32 cell_index = (chunk_cell_y << CELL_CHUNK_SIZE_BITS) | (x & CELL_CHUNK_MASK);
+        chunk->cell_exists[cell_index / 32] |= 1 << (cell_index % 32);
+        ++chunk->n_cells;
+
+        Cell *cell = chunk->cells + cell_index;
+        cell->type = (CellType)run->type;
+        cell->pause = run->value;
       }
-      else if (in_rectangle(Vec2(x, y), bottom_right_bounds))
+    }
+  }
+
+  if (chunk)
+  {
+    link_chunk_cell_neighbours(maze, chunk);
+    link_chunk_edges_to_row_runs(maze, chunk);
+  }
+
+  return chunk;
+}
+
+
+CellChunk *
+find_or_create_chunk(Maze *maze, u32 chunk_x, u32 chunk_y, Memory *memory = 0)
+{
+  CellChunk *chunk = 0;
+
+  if (maze->last_chunk &&
+      maze->last_chunk->chunk_x == chunk_x &&
+      maze->last_chunk->chunk_y == chunk_y)
+  {
+    chunk = maze->last_chunk;
+  }
+  else
+  {
+    chunk = find_chunk_in_hash(maze, chunk_x, chunk_y);
+  }
+
+  if (!chunk && maze->row_runs)
+  {
+    chunk = build_chunk_from_runs(maze, chunk_x, chunk_y);
+  }
+
+  if (!chunk && memory)
+  {
+    chunk = create_chunk(maze, chunk_x, chunk_y, memory);
+  }
+
+  if (chunk)
+  {
+    maze->last_chunk = chunk;
+  }
+
+  return chunk;
+}
+
+
+// Spreads the bits of value out to the even bits of the result
+u64
+spread_morton_bits(u32 value)
+{
+  u64 result = value;
+  result = (result | (result << 16)) & 0x0000FFFF0000FFFF;
+  result = (result | (result << 8)) & 0x00FF00FF00FF00FF;
+  result = (result | (result << 4)) & 0x0F0F0F0F0F0F0F0F;
+  result = (result | (result << 2)) & 0x3333333333333333;
+  result = (result | (result << 1)) & 0x5555555555555555;
+  return result;
+}
+
+
+u64
+get_chunk_morton_key(CellChunk *chunk)
+{
+  u64 result = spread_morton_bits(chunk->chunk_x) | (spread_morton_bits(chunk->chunk_y) << 1);
+  return result;
+}
+
+
+int
+compare_morton_chunks(const void *a, const void *b)
+{
+  u64 a_key = ((const MortonChunk *)a)->key;
+  u64 b_key = ((const MortonChunk *)b)->key;
+  int result = (a_key > b_key) - (a_key < b_key);
+  return result;
+}
+
+
+int
+compare_chunk_addresses(const void *a, const void *b)
+{
+  CellChunk *a_chunk = *(CellChunk *const *)a;
+  CellChunk *b_chunk = *(CellChunk *const *)b;
+  int result = (a_chunk > b_chunk) - (a_chunk < b_chunk);
+  return result;
+}
+
+
+// Moves the chunks' cells between the chunks so the chunks are in Morton
+//   order of their positions in memory, and chains them in that order.
+//   The chunks stay where they are, so no more memory is used.
+void
+order_maze_chunks(Maze *maze, Memory *memory)
+{
+  b32 ordered = true;
+  CellChunk *chunk = maze->first_chunk;
+  while (chunk && chunk->next_chunk)
+  {
+    if (chunk->next_chunk < chunk ||
+        get_chunk_morton_key(chunk->next_chunk) < get_chunk_morton_key(chunk))
+    {
+      ordered = false;
+      break;
+    }
+    chunk = chunk->next_chunk;
+  }
+
+  if (!ordered)
+  {
+    // NOTE: The arrays are only needed here, so their memory is given
+    //         back afterwards.
+    size_t memory_used = memory->used;
+    MortonChunk *morton_chunks = push_structs(memory, MortonChunk, maze->n_chunks);
+    CellChunk **slots = push_structs(memory, CellChunk *, maze->n_chunks);
+
+    u32 n_chunks = 0;
+    chunk = maze->first_chunk;
+    while (chunk)
+    {
+      morton_chunks[n_chunks].key = get_chunk_morton_key(chunk);
+      morton_chunks[n_chunks].chunk = chunk;
+      slots[n_chunks] = chunk;
+      ++n_chunks;
+      chunk = chunk->next_chunk;
+    }
+
+    qsort(morton_chunks, n_chunks, sizeof(MortonChunk), compare_morton_chunks);
+    qsort(slots, n_chunks, sizeof(CellChunk *), compare_chunk_addresses);
+
+    // The nth chunk in Morton order moves to the nth chunk in memory, each
+    //   chunk's next_chunk is used for where it moves to, and is pointed
+    //   at itself once the chunk is in place.
+    for (u32 chunk_index = 0;
+         chunk_index < n_chunks;
+         ++chunk_index)
+    {
+      morton_chunks[chunk_index].chunk->next_chunk = slots[chunk_index];
+    }
+
+    for (u32 chunk_index = 0;
+         chunk_index < n_chunks;
+         ++chunk_index)
+    {
+      CellChunk *cycle_start = slots[chunk_index];
+      if (cycle_start->next_chunk != cycle_start)
       {
-        if (!tree->bottom_right)
+        CellChunk moving_chunk = *cycle_start;
+        while (true)
         {
-          tree->bottom_right = create_tree(memory, bottom_right_bounds);
+          CellChunk *destination = moving_chunk.next_chunk;
+          CellChunk displaced_chunk = *destination;
+
+          *destination = moving_chunk;
+          destination->next_chunk = destination;
+
+          if (destination == cycle_start)
+          {
+            break;
+          }
+          moving_chunk = displaced_chunk;
         }
-        tree = tree->bottom_right;
       }
-      else if (in_rectangle(Vec2(x, y), bottom_left_bounds))
+    }
+
+    zero_n(maze->chunk_hash, CellChunk *, maze->chunk_hash_size);
+    // NOTE: The active and dirty chains would be broken by the move, but
+    //         the chunks are ordered as the maze is loaded, before anything
+    //         is listed in them.
+    for (u32 chunk_index = 0;
+         chunk_index < n_chunks;
+         ++chunk_index)
+    {
+      chunk = slots[chunk_index];
+      chunk->next_chunk = chunk_index + 1 < n_chunks ? slots[chunk_index + 1] : 0;
+      chunk->active_tick = 0;
+      chunk->dirty = false;
+      zero_n(chunk->cell_dirty, u32, CELLS_PER_CHUNK / 32);
+      insert_chunk_into_hash(maze->chunk_hash, maze->chunk_hash_size, chunk);
+    }
+
+    maze->first_chunk = slots[0];
+    maze->last_chunk = 0;
+    maze->first_active_chunk = 0;
+    maze->n_active_chunks = 0;
+    maze->first_dirty_chunk = 0;
+
+    memory->used = memory_used;
+
+    log(L_CellsStorage, u8("Ordered %u chunks"), n_chunks);
+  }
+}
+
+
+// Adds chunks which have already been filled in, e.g. from a compiled
+//   maze file, to the maze. They are chained in the order given, so if
+//   the maze is empty they are iterated over in that order.
+void
+add_filled_chunks(Maze *maze, Memory *memory, CellChunk *chunks, u32 n_chunks)
+{
+  while (2 * (maze->n_chunks + n_chunks) > maze->chunk_hash_size)
+  {
+    grow_chunk_hash(maze, memory);
+  }
+
+  for (s32 chunk_index = n_chunks - 1;
+       chunk_index >= 0;
+       --chunk_index)
+  {
+    CellChunk *chunk = chunks + chunk_index;
+
+    chunk->next_chunk = maze->first_chunk;
+    maze->first_chunk = chunk;
+    ++maze->n_chunks;
+
+    insert_chunk_into_hash(maze->chunk_hash, maze->chunk_hash_size, chunk);
+  }
+
+  maze->last_chunk = 0;
+}
+
+
+b32
+chunk_cell_exists(CellChunk *chunk, u32 cell_index)
+{
+  b32 result = (chunk->cell_exists[cell_index / 32] >> (cell_index % 32)) & 1;
+  return result;
+}
+
+
+u32
+get_cell_index_in_chunk(u32 x, u32 y)
+{
+  u32 result = ((y & CELL_CHUNK_MASK) << CELL_CHUNK_SIZE_BITS) | (x & CELL_CHUNK_MASK);
+  return result;
+}
+
+
+u32
+get_chunk_cell_x(CellChunk *chunk, u32 cell_index)
+{
+  u32 result = (chunk->chunk_x << CELL_CHUNK_SIZE_BITS) | (cell_index & CELL_CHUNK_MASK);
+  return result;
+}
+
+
+u32
+get_chunk_cell_y(CellChunk *chunk, u32 cell_index)
+{
+  u32 result = (chunk->chunk_y << CELL_CHUNK_SIZE_BITS) | (cell_index >> CELL_CHUNK_SIZE_BITS);
+  return result;
+}
+
+
+Cell *
+find_or_create_cell(Maze *maze, u32 x, u32 y, Memory *memory = 0)
+{
+  Cell *cell = 0;
+
+  CellChunk *chunk = find_or_create_chunk(maze, x >> CELL_CHUNK_SIZE_BITS, y >> CELL_CHUNK_SIZE_BITS, memory);
+  if (chunk)
+  {
+    u32 cell_index = get_cell_index_in_chunk(x, y);
+
+    if (chunk_cell_exists(chunk, cell_index))
+    {
+      cell = chunk->cells + cell_index;
+    }
+    else if (memory)
+    {
+      chunk->cell_exists[cell_index / 32] |= 1 << (cell_index % 32);
+      ++chunk->n_cells;
+
+      cell = chunk->cells + cell_index;
+
+      ++maze->stats.n_cells;
+      ++maze->stats.n_cells_of_type[CELL_NULL];
+    }
+  }
+
+  return cell;
+}
+
+
+//
+// Cell type indices
+//
+
+// Returns false if there was no memory to grow the index with, and the
+//   indices have been marked stale.
+b32
+add_to_cell_type_index(Maze *maze, CellType type, u32 x, u32 y, Memory *memory)
+{
+  b32 result = true;
+
+  if (CELL_TYPE_INDEXED[type] && !maze->type_indices_stale)
+  {
+    CellTypeIndex *index = maze->type_indices + type;
+    if (index->n_positions == index->size)
+    {
+      if (memory)
       {
-        if (!tree->bottom_left)
-        {
-          tree->bottom_left = create_tree(memory, bottom_left_bounds);
-        }
-        tree = tree->bottom_left;
+        // NOTE: The old array is left in the arena, like the chunk hash.
+        u32 new_size = index->size ? 2 * index->size : INITIAL_CELL_TYPE_INDEX_SIZE;
+        CellPosition *new_positions = push_structs(memory, CellPosition, new_size);
+        memcpy(new_positions, index->positions, index->n_positions * sizeof(CellPosition));
+
+        index->positions = new_positions;
+        index->size = new_size;
       }
       else
       {
-        // NOTE: If it gets here: it is in old-tree but not any of it's
-        //       subdivisions, therefore: doesn't exist.
+        maze->type_indices_stale = true;
+        result = false;
+      }
+    }
+
+    if (result)
+    {
+      CellPosition *position = index->positions + index->n_positions++;
+      position->x = x;
+      position->y = y;
+    }
+  }
+
+  return result;
+}
+
+
+void
+remove_from_cell_type_index(Maze *maze, CellType type, u32 x, u32 y)
+{
+  if (type == CELL_ONCE)
+  {
+    // NOTE: The sim turns ONCE cells into walls as the cars go over them,
+    //         and there can be many, so they aren't searched for.
+    maze->type_indices_stale = true;
+  }
+  else if (CELL_TYPE_INDEXED[type] && !maze->type_indices_stale)
+  {
+    CellTypeIndex *index = maze->type_indices + type;
+    for (u32 position_index = 0;
+         position_index < index->n_positions;
+         ++position_index)
+    {
+      CellPosition *position = index->positions + position_index;
+      if (position->x == x && position->y == y)
+      {
+        *position = index->positions[--index->n_positions];
         break;
       }
     }
-    log(L_CellsStorage, u8("Got cell from quadtree"));
+  }
+}
+
+
+// Call before changing the cell's type, with memory if the cell might
+//   need adding to an index.
+void
+update_cell_type_index(Maze *maze, Cell *cell, u32 x, u32 y, CellType new_type, Memory *memory)
+{
+  if (cell->type != new_type)
+  {
+    remove_from_cell_type_index(maze, cell->type, x, y);
+    add_to_cell_type_index(maze, new_type, x, y, memory);
+  }
+}
+
+
+void
+clear_cell_type_indices(Maze *maze)
+{
+  for (u32 type = 0;
+       type < N_CELL_TYPES;
+       ++type)
+  {
+    maze->type_indices[type].n_positions = 0;
+  }
+  maze->type_indices_stale = false;
+}
+
+
+void
+clear_maze(Maze *maze)
+{
+  CellChunk *chunk = maze->first_chunk;
+  if (chunk)
+  {
+    while (chunk->next_chunk)
+    {
+      chunk = chunk->next_chunk;
+    }
+
+    // Put free chain on end of current chunk chain,
+    //   then put chunk chain on free chain
+    chunk->next_chunk = maze->free_chain;
+    maze->free_chain = maze->first_chunk;
+    maze->first_chunk = 0;
+  }
+
+  if (maze->chunk_hash)
+  {
+    zero_n(maze->chunk_hash, CellChunk *, maze->chunk_hash_size);
+  }
+  maze->n_chunks = 0;
+
+  maze->first_active_chunk = 0;
+  maze->n_active_chunks = 0;
+  maze->first_dirty_chunk = 0;
+
+  maze->last_chunk = 0;
+
+  zero(&maze->stats, MazeStats);
+  clear_cell_type_indices(maze);
+
+  if (maze->row_runs)
+  {
+    maze->row_runs->n_runs = 0;
+    maze->row_runs->n_rows = 0;
+  }
+}
+
+
+b32
+maze_has_bounds(MazeStats *stats)
+{
+  b32 result = stats->n_cells > stats->n_cells_of_type[CELL_NULL];
+  return result;
+}
+
+
+void
+add_to_maze_bounds(MazeStats *stats, MazeBounds *bounds)
+{
+  if (maze_has_bounds(stats))
+  {
+    stats->bounds.min_x = min(stats->bounds.min_x, bounds->min_x);
+    stats->bounds.min_y = min(stats->bounds.min_y, bounds->min_y);
+    stats->bounds.max_x = max(stats->bounds.max_x, bounds->max_x);
+    stats->bounds.max_y = max(stats->bounds.max_y, bounds->max_y);
+  }
+  else
+  {
+    stats->bounds = *bounds;
+  }
+}
+
+
+// Adds the next cell in the text to the runs, the cells must be added in
+//   order.
+void
+add_cell_to_row_runs(Maze *maze, u32 x, u32 y, CellType type, u16 value)
+{
+  RowRuns *row_runs = maze->row_runs;
+
+  while (row_runs->n_rows <= y)
+  {
+    if (row_runs->n_rows == row_runs->rows_size)
+    {
+      // NOTE: The old index is left in the arena, like the chunk hash.
+      u32 new_rows_size = row_runs->rows_size ? 2 * row_runs->rows_size : INITIAL_ROW_RUNS_SIZE;
+      u64 *new_row_first_run = push_structs(row_runs->memory, u64, new_rows_size);
+      memcpy(new_row_first_run, row_runs->row_first_run, row_runs->n_rows * sizeof(u64));
+
+      row_runs->row_first_run = new_row_first_run;
+      row_runs->rows_size = new_rows_size;
+    }
+
+    row_runs->row_first_run[row_runs->n_rows++] = row_runs->n_runs;
+  }
 
-    // Add all cells in quadtree block to hash cache
-    if (cell)
+  CellRun *last_run = row_runs->n_runs > row_runs->row_first_run[y] ? row_runs->runs + row_runs->n_runs - 1 : 0;
+
+  if (last_run &&
+      (u64)last_run->start_x + last_run->length == x &&
+      last_run->type == type &&
+      last_run->value == value)
+  {
+    ++last_run->length;
+  }
+  else
+  {
+    if (row_runs->n_runs == row_runs->runs_size)
+    {
+      u64 new_runs_size = row_runs->runs_size ? 2 * row_runs->runs_size : INITIAL_ROW_RUNS_SIZE;
+      CellRun *new_runs = push_structs(row_runs->memory, CellRun, new_runs_size);
+      memcpy(new_runs, row_runs->runs, row_runs->n_runs * sizeof(CellRun));
+
+      row_runs->runs = new_runs;
+      row_runs->runs_size = new_runs_size;
+    }
+
+    CellRun *run = row_runs->runs + row_runs->n_runs++;
+    run->start_x = x;
+    run->length = 1;
+    run->type = type;
+    run->value = value;
+  }
+
+  MazeBounds cell_bounds = {x, y, x, y};
+  add_to_maze_bounds(&maze->stats, &cell_bounds);
+  ++maze->stats.n_cells;
+  ++maze->stats.n_cells_of_type[type];
+
+  add_to_cell_type_index(maze, type, x, y, row_runs->memory);
+}
+
+
+// Call before changing the cell's type, to keep the maze's stats up to
+//   date.
+void
+update_maze_stats(Maze *maze, Cell *cell, u32 x, u32 y, CellType new_type)
+{
+  MazeStats *stats = &maze->stats;
+
+  if (new_type != CELL_NULL)
+  {
+    MazeBounds cell_bounds = {x, y, x, y};
+    add_to_maze_bounds(stats, &cell_bounds);
+  }
+  else if (cell->type != CELL_NULL)
+  {
+    if (x == stats->bounds.min_x || x == stats->bounds.max_x ||
+        y == stats->bounds.min_y || y == stats->bounds.max_y)
+    {
+      stats->bounds_stale = true;
+    }
+  }
+
+  --stats->n_cells_of_type[cell->type];
+  ++stats->n_cells_of_type[new_type];
+}
+
+
+// NOTE: Only used after a cell on the edge of the bounds was removed
+void
+find_maze_bounds(Maze *maze)
+{
+  MazeStats *stats = &maze->stats;
+  b32 found_cell = false;
+
+  CellChunk *chunk = maze->first_chunk;
+  while (chunk)
+  {
+    // NOTE: Only chunks reaching outside the bounds so far need their
+    //         cells checking.
+    u32 chunk_min_x = chunk->chunk_x << CELL_CHUNK_SIZE_BITS;
+    u32 chunk_min_y = chunk->chunk_y << CELL_CHUNK_SIZE_BITS;
+    u32 chunk_max_x = chunk_min_x + CELL_CHUNK_MASK;
+    u32 chunk_max_y = chunk_min_y + CELL_CHUNK_MASK;
+
+    if (!found_cell ||
+        chunk_min_x < stats->bounds.min_x || chunk_max_x > stats->bounds.max_x ||
+        chunk_min_y < stats->bounds.min_y || chunk_max_y > stats->bounds.max_y)
     {
-      log(L_CellsStorage, u8("Putting block of cells in hash"));
       for (u32 cell_index = 0;
-           cell_index < tree->used;
+           cell_index < CELLS_PER_CHUNK;
            ++cell_index)
       {
-        Cell *cell_to_cache = tree->cells + cell_index;
-        Cell **hash_slot = get_cell_from_hash(maze, cell->x, cell->y);
-        *hash_slot = cell_to_cache;
+        if (chunk_cell_exists(chunk, cell_index))
+        {
+          Cell *cell = chunk->cells + cell_index;
+          if (cell->type != CELL_NULL)
+          {
+            u32 x = get_chunk_cell_x(chunk, cell_index);
+            u32 y = get_chunk_cell_y(chunk, cell_index);
+            if (!found_cell)
+            {
+              stats->bounds = {x, y, x, y};
+              found_cell = true;
+            }
+            stats->bounds.min_x = min(stats->bounds.min_x, x);
+            stats->bounds.min_y = min(stats->bounds.min_y, y);
+            stats->bounds.max_x = max(stats->bounds.max_x, x);
+            stats->bounds.max_y = max(stats->bounds.max_y, y);
+          }
+        }
       }
     }
+
+    chunk = chunk->next_chunk;
   }
 
-  return cell;
+  // NOTE: Runs under built chunks are counted even if their cells have
+  //         been removed from the chunk, only the editor removes cells.
+  RowRuns *row_runs = maze->row_runs;
+  for (u32 y = 0;
+       row_runs && y < row_runs->n_rows;
+       ++y)
+  {
+    u64 first_run;
+    u64 end_run;
+    if (get_row_runs_range(row_runs, y, &first_run, &end_run))
+    {
+      CellRun *last_run = row_runs->runs + end_run - 1;
+      MazeBounds row_bounds = {row_runs->runs[first_run].start_x, y, last_run->start_x + last_run->length - 1, y};
+      if (!found_cell)
+      {
+        stats->bounds = row_bounds;
+        found_cell = true;
+      }
+      stats->bounds.min_x = min(stats->bounds.min_x, row_bounds.min_x);
+      stats->bounds.min_y = min(stats->bounds.min_y, row_bounds.min_y);
+      stats->bounds.max_x = max(stats->bounds.max_x, row_bounds.max_x);
+      stats->bounds.max_y = max(stats->bounds.max_y, row_bounds.max_y);
+    }
+  }
+
+  stats->bounds_stale = false;
 }
 
 
-void
-clear_cells_from_quadtree(QuadTree *tree)
+// The bounds of the cells which aren't CELL_NULL, zero if there are none
+MazeBounds
+get_maze_bounds(Maze *maze)
 {
-  if (tree)
-  {
-    tree->used = 0;
+  MazeBounds result = {};
 
-    clear_cells_from_quadtree(tree->top_right);
-    clear_cells_from_quadtree(tree->top_left);
-    clear_cells_from_quadtree(tree->bottom_right);
-    clear_cells_from_quadtree(tree->bottom_left);
+  if (maze_has_bounds(&maze->stats))
+  {
+    if (maze->stats.bounds_stale)
+    {
+      find_maze_bounds(maze);
+    }
+    result = maze->stats.bounds;
   }
+
+  return result;
 }
 
 
+u64
+get_n_cells_of_type(Maze *maze, CellType type)
+{
+  u64 result = maze->stats.n_cells_of_type[type];
+  return result;
+}
+
+
+// Moves all of from's chunks into the maze, chained as if they had been
+//   created in the maze in the order they were created in from. Chunks
+//   which the maze already has have their cells copied in, and are put
+//   on the maze's free chain.
 void
-clear_maze(Maze *maze)
+merge_maze_chunks(Maze *maze, Memory *memory, Maze *from)
 {
-  clear_cells_from_quadtree(&maze->tree);
-  zero_n(&maze->cache_hash, Cell*, CELL_CACHE_SIZE);
+  if (maze_has_bounds(&from->stats))
+  {
+    add_to_maze_bounds(&maze->stats, &from->stats.bounds);
+  }
+  maze->stats.bounds_stale |= from->stats.bounds_stale;
+  maze->stats.n_cells += from->stats.n_cells;
+  for (u32 type = 0;
+       type < N_CELL_TYPES;
+       ++type)
+  {
+    maze->stats.n_cells_of_type[type] += from->stats.n_cells_of_type[type];
+
+    CellTypeIndex *from_index = from->type_indices + type;
+    for (u32 position_index = 0;
+         position_index < from_index->n_positions;
+         ++position_index)
+    {
+      CellPosition *position = from_index->positions + position_index;
+      add_to_cell_type_index(maze, (CellType)type, position->x, position->y, memory);
+    }
+  }
+  maze->type_indices_stale |= from->type_indices_stale;
+
+  while (2 * (maze->n_chunks + from->n_chunks) > maze->chunk_hash_size)
+  {
+    grow_chunk_hash(maze, memory);
+  }
+
+  // New chunks are put on the front of the chain, so reverse it to get
+  //   them in the order they were created.
+  CellChunk *created_chunks = 0;
+  CellChunk *chunk = from->first_chunk;
+  while (chunk)
+  {
+    CellChunk *next_chunk = chunk->next_chunk;
+    chunk->next_chunk = created_chunks;
+    created_chunks = chunk;
+    chunk = next_chunk;
+  }
+
+  chunk = created_chunks;
+  while (chunk)
+  {
+    CellChunk *next_chunk = chunk->next_chunk;
+
+    CellChunk *existing_chunk = find_chunk_in_hash(maze, chunk->chunk_x, chunk->chunk_y);
+    if (existing_chunk)
+    {
+      for (u32 cell_index = 0;
+           cell_index < CELLS_PER_CHUNK;
+           ++cell_index)
+      {
+        if (chunk_cell_exists(chunk, cell_index))
+        {
+          existing_chunk->cell_exists[cell_index / 32] |= 1 << (cell_index % 32);
+          existing_chunk->cells[cell_index] = chunk->cells[cell_index];
+        }
+      }
+      existing_chunk->n_cells += chunk->n_cells;
+
+      chunk->next_chunk = maze->free_chain;
+      maze->free_chain = chunk;
+    }
+    else
+    {
+      chunk->next_chunk = maze->first_chunk;
+      maze->first_chunk = chunk;
+      ++maze->n_chunks;
+
+      insert_chunk_into_hash(maze->chunk_hash, maze->chunk_hash_size, chunk);
+    }
+
+    chunk = next_chunk;
+  }
+
+  from->first_chunk = 0;
+  clear_maze(from);
+
+  maze->last_chunk = 0;
 }
 
 
@@ -160,8 +985,207 @@ get_cell(Maze *maze, u32 x, u32 y)
 }
 
 
+// NOTE: Unlike get_cell(maze, x, y) this doesn't touch maze->last_chunk, so
+//         it can be called from several threads at once as long as each
+//         thread passes its own last_chunk.
+Cell *
+get_cell(Maze *maze, u32 x, u32 y, CellChunk **last_chunk)
+{
+  Cell *cell = 0;
+
+  u32 chunk_x = x >> CELL_CHUNK_SIZE_BITS;
+  u32 chunk_y = y >> CELL_CHUNK_SIZE_BITS;
+
+  CellChunk *chunk = *last_chunk;
+  if (!chunk ||
+      chunk->chunk_x != chunk_x ||
+      chunk->chunk_y != chunk_y)
+  {
+    chunk = find_chunk_in_hash(maze, chunk_x, chunk_y);
+    *last_chunk = chunk;
+  }
+
+  if (chunk)
+  {
+    u32 cell_index = get_cell_index_in_chunk(x, y);
+    if (chunk_cell_exists(chunk, cell_index))
+    {
+      cell = chunk->cells + cell_index;
+    }
+  }
+
+  return cell;
+}
+
+
+//
+// Active chunks
+//
+
+void
+clear_active_chunks(Maze *maze)
+{
+  // NOTE: The chunks' active_ticks aren't cleared, they are out of date
+  //         as soon as the maze's tick moves on.
+  ++maze->active_tick;
+  maze->first_active_chunk = 0;
+  maze->n_active_chunks = 0;
+}
+
+
+void
+add_active_chunk(Maze *maze, CellChunk *chunk)
+{
+  if (chunk->active_tick != maze->active_tick)
+  {
+    chunk->active_tick = maze->active_tick;
+    chunk->next_active_chunk = maze->first_active_chunk;
+    maze->first_active_chunk = chunk;
+    ++maze->n_active_chunks;
+  }
+}
+
+
+void
+mark_cell_dirty(Maze *maze, u32 x, u32 y)
+{
+  CellChunk *chunk = find_or_create_chunk(maze, x >> CELL_CHUNK_SIZE_BITS, y >> CELL_CHUNK_SIZE_BITS);
+  if (chunk)
+  {
+    if (!chunk->dirty)
+    {
+      chunk->dirty = true;
+      chunk->next_dirty_chunk = maze->first_dirty_chunk;
+      maze->first_dirty_chunk = chunk;
+    }
+
+    u32 cell_index = get_cell_index_in_chunk(x, y);
+    chunk->cell_dirty[cell_index / 32] |= 1 << (cell_index % 32);
+  }
+}
+
+
+// Takes the next chunk off the dirty chain, the caller clears its
+//   cell_dirty bitmap as it uses it.
+CellChunk *
+pop_dirty_chunk(Maze *maze)
+{
+  CellChunk *chunk = maze->first_dirty_chunk;
+  if (chunk)
+  {
+    maze->first_dirty_chunk = chunk->next_dirty_chunk;
+    chunk->next_dirty_chunk = 0;
+    chunk->dirty = false;
+  }
+
+  return chunk;
+}
+
+
 Cell *
 create_new_cell(Maze *maze, u32 x, u32 y, Memory *memory)
 {
   return find_or_create_cell(maze, x, y, memory);
+}
+
+
+Cell *
+cells_iterator(Maze *maze, CellsIterator *iterator)
+{
+  Cell *result = 0;
+
+  // Check if this is a new iterator
+  if (iterator->chunk == 0)
+  {
+    iterator->chunk = maze->first_chunk;
+    iterator->cell_index = 0;
+  }
+
+  while (iterator->chunk && !result)
+  {
+    if (iterator->cell_index >= CELLS_PER_CHUNK)
+    {
+      iterator->chunk = iterator->chunk->next_chunk;
+      iterator->cell_index = 0;
+    }
+    else if (iterator->chunk->cell_exists[iterator->cell_index / 32] == 0)
+    {
+      // Skip the rest of an empty word of the exists bitmap
+      iterator->cell_index = (iterator->cell_index / 32 + 1) * 32;
+    }
+    else
+    {
+      if (chunk_cell_exists(iterator->chunk, iterator->cell_index))
+      {
+        result = iterator->chunk->cells + iterator->cell_index;
+        iterator->x = get_chunk_cell_x(iterator->chunk, iterator->cell_index);
+        iterator->y = get_chunk_cell_y(iterator->chunk, iterator->cell_index);
+      }
+      ++iterator->cell_index;
+    }
+  }
+
+  return result;
+}
+
+
+// Finds the indexed cells from the maze's cells, and its runs under
+//   chunks which haven't been built.
+void
+rebuild_cell_type_indices(Maze *maze, Memory *memory)
+{
+  clear_cell_type_indices(maze);
+
+  CellsIterator iter = {};
+  Cell *cell;
+  while ((cell = cells_iterator(maze, &iter)))
+  {
+    add_to_cell_type_index(maze, cell->type, iter.x, iter.y, memory);
+  }
+
+  RowRuns *row_runs = maze->row_runs;
+  for (u32 y = 0;
+       row_runs && y < row_runs->n_rows;
+       ++y)
+  {
+    u64 first_run;
+    u64 end_run;
+    if (get_row_runs_range(row_runs, y, &first_run, &end_run))
+    {
+      for (u64 run_index = first_run;
+           run_index < end_run;
+           ++run_index)
+      {
+        CellRun *run = row_runs->runs + run_index;
+        if (CELL_TYPE_INDEXED[run->type])
+        {
+          for (u64 x = run->start_x;
+               x < (u64)run->start_x + run->length;
+               ++x)
+          {
+            if (!find_chunk_in_hash(maze, x >> CELL_CHUNK_SIZE_BITS, y >> CELL_CHUNK_SIZE_BITS))
+            {
+              add_to_cell_type_index(maze, (CellType)run->type, x, y, memory);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  log(L_CellsStorage, u8("Rebuilt the cell type indices"));
+}
+
+
+// The positions of all the cells of an indexed type, in no particular
+//   order. The index is found again first if it is stale.
+CellTypeIndex *
+get_cell_type_index(Maze *maze, CellType type, Memory *memory)
+{
+  if (maze->type_indices_stale)
+  {
+    rebuild_cell_type_indices(maze, memory);
+  }
+
+  return maze->type_indices + type;
 }
\ No newline at end of file
@@ -70,47 +70,270 @@ const u8 *CELL_TYPE_TXT[] =
 };
 
 
-struct Cell
+// Order matches directly_neighbouring_cells(), the opposite neighbour
+//   is (neighbour ^ 1).
+enum CellNeighbour
 {
-  u32 x;
-  u32 y;
-  enum CellType type;
-  u8 name[2];
+  NEIGHBOUR_UP,
+  NEIGHBOUR_DOWN,
+  NEIGHBOUR_RIGHT,
+  NEIGHBOUR_LEFT,
 
-  u32 opengl_instance_position;
+  N_CELL_NEIGHBOURS
+};
 
-  u64 hovered_at_time;
 
-  u64 edit_mode_last_change;
+// Only what the sim needs is kept for each cell, so a cell is four
+//   bytes. Its position is given by where it is stored, and the GUI's
+//   state for cells is kept separately in CellsUIState.
+struct Cell
+{
+  enum CellType type : 7;
+
+  // Set by analyse_corridors()
+  u8 is_corridor : 1;
+
+  // CellConnectedState of each neighbour, two bits each, indexed by
+  //   CellNeighbour.  Set by link_all_cell_neighbours() after parsing
+  //   and kept up to date by set_cell_type().
+  u8 neighbour_states;
 
   union
   {
-    u32 pause;
-    u32 function_index;
+    u16 pause;
+    u16 function_index;
   };
 };
 
-const u32 QUAD_STORE_N = 16;
-struct QuadTree
+// Cells are stored in a sparse grid of fixed size chunks:
+// - Each chunk holds a CELL_CHUNK_SIZE x CELL_CHUNK_SIZE square of
+//     cells, indexed directly by the cell's position in the chunk
+// - Chunks are found through an open-addressing hash table keyed by
+//     the chunk's position, the table is doubled when half full
+// - All chunks are linked together for iterating over every cell
+// - Once a maze is loaded its chunks are put in the Morton (Z) order of
+//     their positions, both in memory and in the chain, so passes over
+//     every cell read memory in order, and nearby chunks are near each
+//     other
+// - When the maze is cleared the chunks are put on a free chain
+
+const u32 CELL_CHUNK_SIZE_BITS = 5;
+const u32 CELL_CHUNK_SIZE = 1 << CELL_CHUNK_SIZE_BITS;
+const u32 CELL_CHUNK_MASK = CELL_CHUNK_SIZE - 1;
+const u32 CELLS_PER_CHUNK = CELL_CHUNK_SIZE * CELL_CHUNK_SIZE;
+
+struct CellChunk
+{
+  u32 chunk_x;
+  u32 chunk_y;
+
+  u32 n_cells;
+  u32 cell_exists[CELLS_PER_CHUNK / 32];
+  Cell cells[CELLS_PER_CHUNK];
+
+  CellChunk *next_chunk;
+
+  // See "Active chunks" below
+  u32 active_tick;
+  CellChunk *next_active_chunk;
+
+  b32 dirty;
+  u32 cell_dirty[CELLS_PER_CHUNK / 32];
+  CellChunk *next_dirty_chunk;
+};
+
+
+struct MortonChunk
+{
+  u64 key;
+  CellChunk *chunk;
+};
+
+
+struct MazeBounds
+{
+  u32 min_x;
+  u32 min_y;
+  u32 max_x;
+  u32 max_y;
+};
+
+
+// Kept up to date by update_maze_stats() as cells are created and change
+//   type, so the maze's size doesn't need finding from its cells.
+struct MazeStats
 {
-  Rectangle bounds;
+  u64 n_cells;
+  u64 n_cells_of_type[N_CELL_TYPES];
 
-  u32 used;
-  Cell cells[QUAD_STORE_N];
+  // The bounds of the cells which aren't CELL_NULL, when there are any
+  MazeBounds bounds;
 
-  QuadTree *top_right;
-  QuadTree *top_left;
-  QuadTree *bottom_right;
-  QuadTree *bottom_left;
+  // NOTE: The bounds can't shrink without looking at the cells, so when a
+  //         cell on their edge becomes CELL_NULL they are found again on
+  //         the next call to get_maze_bounds().
+  b32 bounds_stale;
 };
 
 
-const u32 CELL_CACHE_SIZE = 512;
+// Mazes which are mostly long runs of the same cell, e.g. generated
+//   mazes, can be stored as runs of cells along each row instead:
+// - The parser adds each cell to the runs, extending the row's last run
+//     when the cell is the same as it, instead of creating it in a chunk
+// - Each row's runs are in order of x, and found through the index of
+//     each row's first run, so a cell is found with a binary search
+// - A chunk is built from the runs the first time it is looked up, from
+//     then on the chunk's cells are used instead of the runs, so cells
+//     changed by CELL_ONCE or the editor only change in the chunk
+//
+// NOTE: Chunks are built by get_cell(maze, x, y) but not by the thread
+//         safe get_cell(), so the chunks the cars are on are built at the
+//         start of each tick by perform_cells_sim_tick().
+
+struct CellRun
+{
+  u32 start_x;
+  u32 length;
+
+  u8 type;
+  u16 value;  // The cells' pause or function_index
+};
+
+
+const u32 INITIAL_ROW_RUNS_SIZE = 1024;
+struct RowRuns
+{
+  // Chunks built from the runs are allocated from here
+  Memory *memory;
+
+  CellRun *runs;
+  u64 n_runs;
+  u64 runs_size;
+
+  // The index of each row's first run, rows after n_rows have no runs
+  u64 *row_first_run;
+  u32 n_rows;
+  u32 rows_size;
+};
+
+
+// Cell type indices:
+//
+// The cells of the types which passes look for by type, e.g. the start
+//   cells the cars are spawned from, are listed by type, so they can be
+//   found without looking at every cell:
+// - The parser adds each cell of an indexed type as it creates it, in
+//     the order of the text
+// - set_cell_type() keeps them up to date. Removing a cell from its old
+//     type's index searches the index, but there are few cells of most
+//     indexed types.
+// - Removing a ONCE cell marks the indices stale instead, as the sim
+//     turns each one into a wall when a car goes over it.
+// - When a cell can't be added, because there is no memory to grow the
+//     index with, or when the maze is loaded from a compiled file, the
+//     indices are marked stale. They are found again from the cells by
+//     the next get_cell_type_index().
+
+const b32 CELL_TYPE_INDEXED[] =
+{
+  false,  // CELL_NULL
+  true,   // CELL_START
+  false,  // CELL_PATH
+  false,  // CELL_WALL
+  false,  // CELL_HOLE
+  false,  // CELL_SPLITTER
+  true,   // CELL_FUNCTION
+  true,   // CELL_ONCE
+  true,   // CELL_UP_UNLESS_DETECT
+  true,   // CELL_DOWN_UNLESS_DETECT
+  true,   // CELL_LEFT_UNLESS_DETECT
+  true,   // CELL_RIGHT_UNLESS_DETECT
+  true,   // CELL_INP
+  true,   // CELL_OUT
+  false,  // CELL_UP
+  false,  // CELL_DOWN
+  false,  // CELL_LEFT
+  false,  // CELL_RIGHT
+  false   // CELL_PAUSE
+};
+
+
+struct CellPosition
+{
+  u32 x;
+  u32 y;
+};
+
+
+const u32 INITIAL_CELL_TYPE_INDEX_SIZE = 64;
+struct CellTypeIndex
+{
+  CellPosition *positions;
+  u32 n_positions;
+  u32 size;
+};
+
+
+// Active chunks:
+//
+// Only a few chunks of a big maze have anything happening in them at
+//   once, so the chunks which do are chained together, for passes which
+//   only need to look at those instead of the whole maze:
+// - The active chunks hold cars, they are listed at the start of each
+//     tick by perform_cells_sim_tick(). Each chunk records the tick it
+//     was last listed on, so it is only listed once.
+// - The dirty chunks have cells which have changed type since they were
+//     last uploaded to the GUI's cell instances, the changed cells are
+//     marked in the chunk's cell_dirty bitmap. The GUI takes the chunks
+//     off the chain as it uploads them. Nothing else does, so they are
+//     only listed when track_dirty_chunks is set.
+//
+// NOTE: Listing the active chunks costs a chunk lookup for each car every
+//         tick, so they are only listed when the maze is stored as runs,
+//         where the chunks the cars are on have to be built anyway, or
+//         when track_active_chunks is set.
+
+const u32 INITIAL_CHUNK_HASH_SIZE = 1024;  // Must be a power of two
 struct Maze
 {
-  Cell *cache_hash[CELL_CACHE_SIZE];
+  CellChunk **chunk_hash;
+  u32 chunk_hash_size;
+  u32 n_chunks;
+
+  // NOTE: Lookups are usually close to the previous lookup, so the
+  //         last chunk found is checked before the hash table.
+  CellChunk *last_chunk;
+
+  CellChunk *first_chunk;
+  CellChunk *free_chain;
+
+  b32 track_active_chunks;
+  u32 active_tick;
+  u32 n_active_chunks;
+  CellChunk *first_active_chunk;
+
+  b32 track_dirty_chunks;
+  CellChunk *first_dirty_chunk;
+
+  MazeStats stats;
+
+  // Only the types in CELL_TYPE_INDEXED are indexed
+  CellTypeIndex type_indices[N_CELL_TYPES];
+  b32 type_indices_stale;
+
+  // Only set when the maze is stored as runs
+  RowRuns *row_runs;
+};
+
+
+struct CellsIterator
+{
+  CellChunk *chunk;
+  u32 cell_index;
 
-  QuadTree tree;
+  // The position of the cell last returned
+  u32 x;
+  u32 y;
 };
 
 
@@ -1,107 +1,53 @@
-u32
-calc_cell_radius(GameState *game_state)
-{
-  return 1 - (game_state->cell_margin * 0.5);
-}
-
-
 void
-update_cells_ui_state(GameState *game_state, Mouse *mouse, WorldSpace _mouse_pos, u64 time_us)
+perform_cells_sim_tick(Memory *memory, SimState *sim)
 {
-  vec2 cell_pos;
-  vec2 mouse_pos;
-  Rectangle cell_bounds = radius_rectangle(cell_pos, calc_cell_radius(game_state));
+  Maze *maze = &sim->maze;
 
-  b32 hide_cell_menu = false;
-  b32 mouse_click = mouse->l_on_up;
-
-  if (in_rectangle(mouse_pos, cell_bounds))
+  if (sim->sim_steps == 0)
   {
-    Cell *cell_hovered_over = get_cell(&game_state->maze, cell_pos.x, cell_pos.y);
-    if (cell_hovered_over && cell_hovered_over->type != CELL_NULL)
+    CellTypeIndex *starts = get_cell_type_index(maze, CELL_START, memory);
+    for (u32 start_index = 0;
+         start_index < starts->n_positions;
+         ++start_index)
     {
-      cell_hovered_over->hovered_at_time = time_us;
-    }
-
-    if (mouse_click)
-    {
-      if (cell_hovered_over)
-      {
-        if (time_us >= cell_hovered_over->edit_mode_last_change + seconds_in_u(0.01))
-        {
-          cell_hovered_over->edit_mode_last_change = time_us;
-
-          open_cell_type_menu(game_state, cell_hovered_over, time_us);
-        }
-      }
-      else
-      {
-        hide_cell_menu = true;
-      }
+      CellPosition *start = starts->positions + start_index;
+      Car new_car = get_new_car(memory, &sim->cars);
+      init_car(&sim->cars, new_car, start->x, start->y);
     }
   }
-  else if (mouse_click)
-  {
-    hide_cell_menu = true;
-  }
 
-  if (hide_cell_menu)
+  if (maze->row_runs || maze->track_active_chunks)
   {
-    game_state->ui.cell_type_menu.cell = 0;
-  }
-}
-
+    // List the chunks the cars are on. When the maze is stored as runs
+    //   this builds them, before the cars are ticked on the sim's
+    //   threads.
+    clear_active_chunks(maze);
 
-void
-perform_cells_sim_tick(Memory *memory, GameState *game_state, QuadTree *tree, u64 time_us)
-{
-  if (game_state->sim_steps == 0)
-  {
-    if (tree)
+    CellChunk *chunk = 0;
+    CarsIterator iter = {};
+    Car car;
+    while (cars_iterator(&sim->cars, &iter, &car))
     {
-      for (u32 cell_index = 0;
-           cell_index < tree->used;
-           ++cell_index)
+      u32 chunk_x = *car_cell_x(car) >> CELL_CHUNK_SIZE_BITS;
+      u32 chunk_y = *car_cell_y(car) >> CELL_CHUNK_SIZE_BITS;
+
+      // NOTE: Cars next to each other in the blocks are usually on the
+      //         same chunk.
+      if (!chunk ||
+          chunk->chunk_x != chunk_x ||
+          chunk->chunk_y != chunk_y)
       {
-        Cell *cell = tree->cells + cell_index;
-
-        if (cell->type == CELL_START)
+        chunk = find_or_create_chunk(maze, chunk_x, chunk_y);
+        if (chunk)
         {
-          Car *new_car = get_new_car(memory, &game_state->cars);
-          init_car(game_state, time_us, new_car, cell->x, cell->y);
+          add_active_chunk(maze, chunk);
         }
       }
-
-      perform_cells_sim_tick(memory, game_state, tree->top_right, time_us);
-      perform_cells_sim_tick(memory, game_state, tree->top_left, time_us);
-      perform_cells_sim_tick(memory, game_state, tree->bottom_right, time_us);
-      perform_cells_sim_tick(memory, game_state, tree->bottom_left, time_us);
     }
   }
 }
 
 
-void
-load_cell_bitmaps(CellBitmaps *cell_bitmaps)
-{
-  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_ENCLOSED], u8("cells/path-enclosed.bmp"));
-  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_SINGLE],   u8("cells/path-single.bmp"));
-  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_L],        u8("cells/path-l.bmp"));
-  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_STRAIGHT], u8("cells/path-straight.bmp"));
-  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_T],        u8("cells/path-t.bmp"));
-  load_bitmap(&cell_bitmaps->walkable[DISP_TYPE_CROSS],    u8("cells/path-cross.bmp"));
-  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_ENCLOSED], u8("cells/unwalkable-enclosed.bmp"));
-  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_SINGLE],   u8("cells/unwalkable-single.bmp"));
-  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_L],        u8("cells/unwalkable-l.bmp"));
-  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_STRAIGHT], u8("cells/unwalkable-straight.bmp"));
-  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_T],        u8("cells/unwalkable-t.bmp"));
-  load_bitmap(&cell_bitmaps->unwalkable[DISP_TYPE_CROSS],    u8("cells/unwalkable-cross.bmp"));
-
-  load_bitmap(&cell_bitmaps->arrow, u8("cells/arrow.bmp"));
-  load_bitmap(&cell_bitmaps->splitter, u8("cells/splitter.bmp"));
-}
-
-
 void
 directly_neighbouring_cells(Cell *neighbours[4], Maze *maze, u32 cell_x, u32 cell_y)
 {
@@ -144,441 +90,238 @@ cell_walkable(Cell *cell)
 }
 
 
-vec4
-get_cell_color(CellType type)
+CellConnectedState
+get_neighbour_state(Cell *cell, CellNeighbour neighbour)
 {
-  vec4 result;
-  switch (type)
-  {
-    case CELL_NULL:     result = (vec4){1, 0.0, 0.0, 0.0};
-      break;
-    case CELL_START:    result = (vec4){1, 0.7, 0.3, 0.3};
-      break;
-    case CELL_PATH:     result = (vec4){1, 0.8, 0.8, 0.9};
-      break;
-    case CELL_WALL:     result = (vec4){1, 0.9, 0.8, 0.9};
-      break;
-    case CELL_HOLE:     result = (vec4){1, 0.0, 0.2, 0.7};
-      break;
-    case CELL_SPLITTER: result = (vec4){1, 0.7, 0.6, 0.0};
-      break;
-    case CELL_FUNCTION: result = (vec4){1, 0.7, 0.5, 0.3};
-      break;
-    case CELL_ONCE:     result = (vec4){1, 0.7, 0.4, 0.0};
-      break;
-    case CELL_UP_UNLESS_DETECT:     result = (vec4){1, 0.0, 0.1, 0.3};
-      break;
-    case CELL_DOWN_UNLESS_DETECT:   result = (vec4){1, 0.0, 0.1, 0.3};
-      break;
-    case CELL_LEFT_UNLESS_DETECT:   result = (vec4){1, 0.0, 0.1, 0.3};
-      break;
-    case CELL_RIGHT_UNLESS_DETECT:  result = (vec4){1, 0.0, 0.1, 0.3};
-      break;
-    case CELL_OUT:      result = (vec4){1, 0.0, 0.1, 0.3};
-      break;
-    case CELL_INP:      result = (vec4){1, 0.0, 0.1, 0.3};
-      break;
-    case CELL_UP:       result = (vec4){1, 0.0, 0.0, 0.0};
-      break;
-    case CELL_DOWN:     result = (vec4){1, 0.3, 0.0, 0.0};
-      break;
-    case CELL_LEFT:     result = (vec4){1, 0.0, 0.1, 0.3};
-      break;
-    case CELL_RIGHT:    result = (vec4){1, 0.3, 0.1, 0.3};
-      break;
-    case CELL_PAUSE:    result = (vec4){1, 0.3, 0.0, 0.7};
-      break;
-
-    default:
-      invalid_code_path;
-      break;
-  }
-
+  CellConnectedState result = (CellConnectedState)((cell->neighbour_states >> (2 * neighbour)) & 3);
   return result;
 }
 
 
 void
-calc_connected_cell_bitmap(Maze *maze, Cell *cell, CellBitmaps *cell_bitmaps, CellDisplay *cell_display_result)
+set_neighbour_state(Cell *cell, CellNeighbour neighbour, CellConnectedState state)
 {
-  cell_display_result->rotate = 0;
-  CellConnectedState walkable = cell_walkable(cell);
+  cell->neighbour_states &= ~(3 << (2 * neighbour));
+  cell->neighbour_states |= state << (2 * neighbour);
+}
 
-  Cell *n[] = {0, 0, 0, 0};
-  directly_neighbouring_cells(n, maze, cell->x, cell->y);
 
-  CellDisplayType cell_display_type;
-  if      (walkable == cell_walkable(n[0]) && walkable == cell_walkable(n[1]) &&
-           walkable == cell_walkable(n[2]) && walkable == cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_CROSS;
-    cell_display_result->rotate = 0;
-  }
-  else if (walkable == cell_walkable(n[0]) && walkable == cell_walkable(n[1]) &&
-           walkable == cell_walkable(n[2]) && walkable != cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_T;
-    cell_display_result->rotate = 90;
-  }
-  else if (walkable == cell_walkable(n[0]) && walkable == cell_walkable(n[1]) &&
-           walkable != cell_walkable(n[2]) && walkable == cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_T;
-    cell_display_result->rotate = 270;
-  }
-  else if (walkable == cell_walkable(n[0]) && walkable != cell_walkable(n[1]) &&
-           walkable == cell_walkable(n[2]) && walkable == cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_T;
-    cell_display_result->rotate = 0;
-  }
-  else if (walkable != cell_walkable(n[0]) && walkable == cell_walkable(n[1]) &&
-           walkable == cell_walkable(n[2]) && walkable == cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_T;
-    cell_display_result->rotate = 180;
-  }
-  else if (walkable == cell_walkable(n[0]) && walkable == cell_walkable(n[1]) &&
-           walkable != cell_walkable(n[2]) && walkable != cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_STRAIGHT;
-    cell_display_result->rotate = 0;
-  }
-  else if (walkable != cell_walkable(n[0]) && walkable != cell_walkable(n[1]) &&
-           walkable == cell_walkable(n[2]) && walkable == cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_STRAIGHT;
-    cell_display_result->rotate = 90;
-  }
-  else if (walkable == cell_walkable(n[0]) && walkable != cell_walkable(n[1]) &&
-           walkable == cell_walkable(n[2]) && walkable != cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_L;
-    cell_display_result->rotate = 0;
-  }
-  else if (walkable == cell_walkable(n[0]) && walkable != cell_walkable(n[1]) &&
-           walkable != cell_walkable(n[2]) && walkable == cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_L;
-    cell_display_result->rotate = 270;
-  }
-  else if (walkable != cell_walkable(n[0]) && walkable == cell_walkable(n[1]) &&
-           walkable == cell_walkable(n[2]) && walkable != cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_L;
-    cell_display_result->rotate = 90;
-  }
-  else if (walkable != cell_walkable(n[0]) && walkable == cell_walkable(n[1]) &&
-           walkable != cell_walkable(n[2]) && walkable == cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_L;
-    cell_display_result->rotate = 180;
-  }
-  else if (walkable == cell_walkable(n[0]) && walkable != cell_walkable(n[1]) &&
-           walkable != cell_walkable(n[2]) && walkable != cell_walkable(n[3]))
-  {
-    cell_display_type = DISP_TYPE_SINGLE;
-    cell_display_result->rotate = 0;
-  }
-  else if (walkable != cell_walkable(n[0]) && walkable == cell_walkable(n[1]) &&
-           walkable != cell_walkable(n[2]) && walkable != cell_walkable(n[3]))
+CellNeighbour
+get_direction_neighbour(vec2 direction)
+{
+  CellNeighbour result;
+
+  if (direction == UP)
   {
-    cell_display_type = DISP_TYPE_SINGLE;
-    cell_display_result->rotate = 180;
+    result = NEIGHBOUR_UP;
   }
-  else if (walkable != cell_walkable(n[0]) && walkable != cell_walkable(n[1]) &&
-           walkable == cell_walkable(n[2]) && walkable != cell_walkable(n[3]))
+  else if (direction == DOWN)
   {
-    cell_display_type = DISP_TYPE_SINGLE;
-    cell_display_result->rotate = 90;
+    result = NEIGHBOUR_DOWN;
   }
-  else if (walkable != cell_walkable(n[0]) && walkable != cell_walkable(n[1]) &&
-           walkable != cell_walkable(n[2]) && walkable == cell_walkable(n[3]))
+  else if (direction == RIGHT)
   {
-    cell_display_type = DISP_TYPE_SINGLE;
-    cell_display_result->rotate = 270;
+    result = NEIGHBOUR_RIGHT;
   }
   else
   {
-    cell_display_type = DISP_TYPE_ENCLOSED;
+    result = NEIGHBOUR_LEFT;
   }
 
-  if (walkable == WALKABLE)
-  {
-    cell_display_result->bitmap = &cell_bitmaps->walkable[cell_display_type];
-  }
-  else
-  {
-    cell_display_result->bitmap = &cell_bitmaps->unwalkable[cell_display_type];
-  }
+  return result;
 }
 
 
-vec2
-get_direction_cell_direction(CellType type)
+void
+link_cell_neighbours(Maze *maze, Cell *cell, u32 cell_x, u32 cell_y)
 {
-  vec2 result = {0, 0};
+  Cell *n[N_CELL_NEIGHBOURS];
+  directly_neighbouring_cells(n, maze, cell_x, cell_y);
 
-  switch (type)
+  for (u32 neighbour = 0;
+       neighbour < N_CELL_NEIGHBOURS;
+       ++neighbour)
   {
-    case CELL_UP:
-    case CELL_UP_UNLESS_DETECT:
-      result = UP;
-      break;
-    case CELL_DOWN:
-    case CELL_DOWN_UNLESS_DETECT:
-      result = DOWN;
-      break;
-    case CELL_LEFT:
-    case CELL_LEFT_UNLESS_DETECT:
-      result = LEFT;
-      break;
-    case CELL_RIGHT:
-    case CELL_RIGHT_UNLESS_DETECT:
-      result = RIGHT;
-      break;
-
-    default: break;
+    set_neighbour_state(cell, (CellNeighbour)neighbour, cell_walkable(n[neighbour]));
   }
-
-  return result;
 }
 
 
-void
-get_overlay_display(CellType type, CellBitmaps *cell_bitmaps, CellDisplay *overlay_display_result)
+Cell *
+get_chunk_cell(CellChunk *chunk, u32 cell_index)
 {
-  vec2 cell_direction = get_direction_cell_direction(type);
-  if (cell_direction != (vec2){0, 0})
-  {
-    overlay_display_result->bitmap = &cell_bitmaps->arrow;
-    overlay_display_result->rotate = angle_from_vector(cell_direction);
-
-    if (type == CELL_UP_UNLESS_DETECT ||
-        type == CELL_DOWN_UNLESS_DETECT ||
-        type == CELL_LEFT_UNLESS_DETECT ||
-        type == CELL_RIGHT_UNLESS_DETECT)
-    {
-      overlay_display_result->color = (vec4){1, 1, 0, 0};
-    }
-    else
-    {
-      overlay_display_result->color = (vec4){1, 1, 1, 1};
-    }
-  }
-  else if (type == CELL_SPLITTER)
-  {
-    overlay_display_result->color = (vec4){1, 1, 1, 1};
-    overlay_display_result->bitmap = &cell_bitmaps->splitter;
-  }
-  else
+  Cell *result = 0;
+  if (chunk && chunk_cell_exists(chunk, cell_index))
   {
-    overlay_display_result->bitmap = 0;
+    result = chunk->cells + cell_index;
   }
+  return result;
 }
 
 
+// NOTE: The neighbouring chunks are looked up once for the chunk
+//         rather than for every cell. Only the chunk's own cells are
+//         changed, so chunks can be linked from several threads at once.
 void
-draw_cell(CellType type, vec2 normalised_world_pos, u32 cell_radius, b32 hovered, CellBitmaps *cell_bitmaps, CellDisplay *cell_display)
+link_chunk_cell_neighbours(Maze *maze, CellChunk *chunk)
 {
-  Bitmap *cell_bitmap;
-  u32 rotate = 0;
-  if (cell_display)
-  {
-    cell_bitmap = cell_display->bitmap;
-    rotate = cell_display->rotate;
-  }
-  else
+  CellChunk *neighbour_chunks[N_CELL_NEIGHBOURS];
+  neighbour_chunks[NEIGHBOUR_UP] = find_chunk_in_hash(maze, chunk->chunk_x, chunk->chunk_y - 1);
+  neighbour_chunks[NEIGHBOUR_DOWN] = find_chunk_in_hash(maze, chunk->chunk_x, chunk->chunk_y + 1);
+  neighbour_chunks[NEIGHBOUR_RIGHT] = find_chunk_in_hash(maze, chunk->chunk_x + 1, chunk->chunk_y);
+  neighbour_chunks[NEIGHBOUR_LEFT] = find_chunk_in_hash(maze, chunk->chunk_x - 1, chunk->chunk_y);
+
+  for (u32 cell_index = 0;
+       cell_index < CELLS_PER_CHUNK;
+       ++cell_index)
   {
-    if (cell_walkable(type) == WALKABLE)
+    if (!chunk_cell_exists(chunk, cell_index))
     {
-      cell_bitmap = &cell_bitmaps->walkable[DISP_TYPE_CROSS];
+      continue;
     }
-    else
+
+    Cell *cell = chunk->cells + cell_index;
+    u32 x = cell_index & CELL_CHUNK_MASK;
+    u32 y = cell_index >> CELL_CHUNK_SIZE_BITS;
+
+    // Cells on the edge of the chunk wrap round to the opposite edge
+    //   of the neighbouring chunk.
+    Cell *n[N_CELL_NEIGHBOURS];
+    n[NEIGHBOUR_UP] = y > 0 ?
+      get_chunk_cell(chunk, cell_index - CELL_CHUNK_SIZE) :
+      get_chunk_cell(neighbour_chunks[NEIGHBOUR_UP], cell_index + CELLS_PER_CHUNK - CELL_CHUNK_SIZE);
+    n[NEIGHBOUR_DOWN] = y < CELL_CHUNK_MASK ?
+      get_chunk_cell(chunk, cell_index + CELL_CHUNK_SIZE) :
+      get_chunk_cell(neighbour_chunks[NEIGHBOUR_DOWN], cell_index - CELLS_PER_CHUNK + CELL_CHUNK_SIZE);
+    n[NEIGHBOUR_RIGHT] = x < CELL_CHUNK_MASK ?
+      get_chunk_cell(chunk, cell_index + 1) :
+      get_chunk_cell(neighbour_chunks[NEIGHBOUR_RIGHT], cell_index - CELL_CHUNK_MASK);
+    n[NEIGHBOUR_LEFT] = x > 0 ?
+      get_chunk_cell(chunk, cell_index - 1) :
+      get_chunk_cell(neighbour_chunks[NEIGHBOUR_LEFT], cell_index + CELL_CHUNK_MASK);
+
+    for (u32 neighbour = 0;
+         neighbour < N_CELL_NEIGHBOURS;
+         ++neighbour)
     {
-      cell_bitmap = &cell_bitmaps->unwalkable[DISP_TYPE_CROSS];
+      set_neighbour_state(cell, (CellNeighbour)neighbour, cell_walkable(n[neighbour]));
     }
   }
-
-  vec4 color = get_cell_color(type);
-  if (hovered)
-  {
-    color.r = min(color.r + 0.15, 1.0f);
-    color.g = min(color.g + 0.15, 1.0f);
-    color.b = min(color.b + 0.15, 1.0f);
-  }
-
-  CellDisplay overlay_display;
-  get_overlay_display(type, cell_bitmaps, &overlay_display);
-
-  glPushMatrix();
-    glTranslatef(normalised_world_pos.x, normalised_world_pos.y, 0);
-    glColor3f(color.r, color.g, color.b);
-
-    draw_box();
-  glPopMatrix();
-
-  normalised_world_pos -= cell_radius;
-  // BlitBitmapOptions opts;
-  // get_default_blit_bitmap_options(&opts);
-  // opts.scale = 2.0*cell_radius / (r32)cell_bitmap->file->width;
-  // opts.interpolation = false;
-
-  // opts.color_multiplier = color;
-  // opts.rotate = rotate;
-  // draw_bitmap(cell_bitmap, normalised_world_pos, &opts);
-
-  // if (overlay_display.bitmap)
-  // {
-  //   opts.rotate = overlay_display.rotate;
-  //   opts.color_multiplier = overlay_display.color;
-  //   opts.scale = 2.0*cell_radius / (r32)overlay_display.bitmap->file->width;
-  //   draw_bitmap(overlay_display.bitmap, normalised_world_pos, &opts);
-  // }
 }
 
 
+// Links the cells on the edges of a chunk built from the maze's runs to
+//   the runs in neighbouring chunks which haven't been built yet.
 void
-recursively_draw_cells(GameState *game_state, RenderWindow *render_window, QuadTree *tree, u32 cell_radius, u64 time_us)
+link_chunk_edges_to_row_runs(Maze *maze, CellChunk *chunk)
 {
-  b32 on_screen = false;
-
-  // Rectangle cell_clip_region_pixels = (Rectangle){render_basis->clip_region.start, render_basis->clip_region.end} / render_basis->world_per_pixel;
-
-  if (tree)
-  {
-    // TODO: Update this to work with opengl
-    // on_screen = overlaps(cell_clip_region_pixels, transform_coord_rect(render_basis, grow(tree->bounds, .5) * game_state->cell_spacing));
-    on_screen = true;
-
-    if (on_screen)
+  u32 min_x = chunk->chunk_x << CELL_CHUNK_SIZE_BITS;
+  u32 min_y = chunk->chunk_y << CELL_CHUNK_SIZE_BITS;
+
+  b32 missing_chunks[N_CELL_NEIGHBOURS];
+  missing_chunks[NEIGHBOUR_UP] = !find_chunk_in_hash(maze, chunk->chunk_x, chunk->chunk_y - 1);
+  missing_chunks[NEIGHBOUR_DOWN] = !find_chunk_in_hash(maze, chunk->chunk_x, chunk->chunk_y + 1);
+  missing_chunks[NEIGHBOUR_RIGHT] = !find_chunk_in_hash(maze, chunk->chunk_x + 1, chunk->chunk_y);
+  missing_chunks[NEIGHBOUR_LEFT] = !find_chunk_in_hash(maze, chunk->chunk_x - 1, chunk->chunk_y);
+
+  for (u32 edge_index = 0;
+       edge_index < CELL_CHUNK_SIZE;
+       ++edge_index)
+  {
+    // The cell on the edge, and the position of its neighbour over the
+    //   edge, for each edge
+    u32 cell_indices[N_CELL_NEIGHBOURS];
+    cell_indices[NEIGHBOUR_UP] = edge_index;
+    cell_indices[NEIGHBOUR_DOWN] = CELLS_PER_CHUNK - CELL_CHUNK_SIZE + edge_index;
+    cell_indices[NEIGHBOUR_RIGHT] = (edge_index << CELL_CHUNK_SIZE_BITS) | CELL_CHUNK_MASK;
+    cell_indices[NEIGHBOUR_LEFT] = edge_index << CELL_CHUNK_SIZE_BITS;
+
+    u32 neighbour_xs[N_CELL_NEIGHBOURS] = {min_x + edge_index, min_x + edge_index, min_x + CELL_CHUNK_SIZE, min_x - 1};
+    u32 neighbour_ys[N_CELL_NEIGHBOURS] = {min_y - 1, min_y + CELL_CHUNK_SIZE, min_y + edge_index, min_y + edge_index};
+
+    for (u32 neighbour = 0;
+         neighbour < N_CELL_NEIGHBOURS;
+         ++neighbour)
     {
-      for (u32 cell_index = 0;
-           cell_index < tree->used;
-           ++cell_index)
+      if (missing_chunks[neighbour] &&
+          chunk_cell_exists(chunk, cell_indices[neighbour]))
       {
-        Cell *cell = tree->cells + cell_index;
-
-        vec2 normalised_cell_pos = world_coord_to_render_window_coord(render_window, cell->x, cell->y);
-
-        CellDisplay cell_display;
-        calc_connected_cell_bitmap(&game_state->maze, cell, &game_state->cell_bitmaps, &cell_display);
-
-        draw_cell(cell->type, normalised_cell_pos, cell_radius, cell->hovered_at_time == time_us, &game_state->cell_bitmaps, &cell_display);
+        CellType neighbour_type = get_row_runs_cell_type(maze->row_runs, neighbour_xs[neighbour], neighbour_ys[neighbour]);
+        set_neighbour_state(chunk->cells + cell_indices[neighbour], (CellNeighbour)neighbour, cell_walkable(neighbour_type));
       }
     }
-
-    recursively_draw_cells(game_state, render_window, tree->top_right, cell_radius, time_us);
-    recursively_draw_cells(game_state, render_window, tree->top_left, cell_radius, time_us);
-    recursively_draw_cells(game_state, render_window, tree->bottom_right, cell_radius, time_us);
-    recursively_draw_cells(game_state, render_window, tree->bottom_left, cell_radius, time_us);
   }
 }
 
 
 void
-recursively_draw_tree_blocks(GameState *game_state, RenderWindow *render_window, QuadTree *tree)
+link_all_cell_neighbours(Maze *maze)
 {
-  // Low-res cell drawing
-  // TODO: Do we still need this with OpenGL rendering?
-
-  if (tree)
+  CellChunk *chunk = maze->first_chunk;
+  while (chunk)
   {
-    vec4 avg_color = {0, 0, 0, 0};
-    Rectangle normalised_bounds = {{0, 0}, {0, 0}};
-    for (u32 cell_index = 0;
-         cell_index < tree->used;
-         ++cell_index)
-    {
-      Cell *cell = tree->cells + cell_index;
-      avg_color += get_cell_color(cell->type);
-
-      vec2 normalised_pos = world_coord_to_render_window_coord(render_window, cell->x, cell->y);
-
-      if (normalised_pos.x < normalised_bounds.start.x)
-      {
-        normalised_bounds.start.x = normalised_pos.x;
-      }
-      if (normalised_pos.y < normalised_bounds.start.y)
-      {
-        normalised_bounds.start.y = normalised_pos.y;
-      }
-      if (normalised_pos.x > normalised_bounds.end.x)
-      {
-        normalised_bounds.end.x = normalised_pos.x;
-      }
-      if (normalised_pos.y > normalised_bounds.end.y)
-      {
-        normalised_bounds.end.y = normalised_pos.y;
-      }
-    }
-    avg_color /= tree->used;
-
-    // TODO: Update this to work with OpenGL
-    // b32 on_screen = overlaps(render_basis->clip_region,  transform_coord_rect(render_basis, tree->bounds*game_state->cell_spacing));
-    b32 on_screen = true;
-
-    if (on_screen)
-    {
-      draw_box(normalised_bounds, avg_color);
-    }
-
-    recursively_draw_tree_blocks(game_state, render_window, tree->top_right);
-    recursively_draw_tree_blocks(game_state, render_window, tree->top_left);
-    recursively_draw_tree_blocks(game_state, render_window, tree->bottom_right);
-    recursively_draw_tree_blocks(game_state, render_window, tree->bottom_left);
+    link_chunk_cell_neighbours(maze, chunk);
+    chunk = chunk->next_chunk;
   }
 }
 
 
+// Without memory, changing the cell to an indexed type marks the type
+//   indices stale.
 void
-draw_cells(GameState *game_state, RenderWindow *render_window, QuadTree *tree, u64 time_us)
+set_cell_type(Maze *maze, Cell *cell, u32 cell_x, u32 cell_y, CellType type, Memory *memory)
 {
-  // TODO:
-  // if (render_basis->scale >= 0.01)
-  if (1)
+  update_maze_stats(maze, cell, cell_x, cell_y, type);
+  update_cell_type_index(maze, cell, cell_x, cell_y, type, memory);
+  cell->type = type;
+  if (maze->track_dirty_chunks)
   {
-    u32 cell_radius = calc_cell_radius(game_state);
+    mark_cell_dirty(maze, cell_x, cell_y);
+  }
 
-    recursively_draw_cells(game_state, render_window, tree, cell_radius, time_us);
+  // Update the neighbours' links back to this cell
+  Cell *n[N_CELL_NEIGHBOURS];
+  directly_neighbouring_cells(n, maze, cell_x, cell_y);
 
-    // Animate highlight for cell which is currently being edited
-    if (game_state->ui.cell_type_menu.cell)
+  CellConnectedState state = cell_walkable(type);
+  for (u32 neighbour = 0;
+       neighbour < N_CELL_NEIGHBOURS;
+       ++neighbour)
+  {
+    if (n[neighbour])
     {
-      if (game_state->ui.cell_type_menu.highlighted_cell_annimation_offset.x == -1)
-      {
-        // No animation if there was no previously highlighted cell
-        game_state->ui.cell_type_menu.highlighted_cell_annimation_offset = (vec2){0, 0};
-      }
-      else
-      {
-        // TODO: Proper animation
-        game_state->ui.cell_type_menu.highlighted_cell_annimation_offset *= 0.3;
-      }
-
-      WorldSpace highlight_world_pos = {
-        game_state->ui.cell_type_menu.cell->x,
-        game_state->ui.cell_type_menu.cell->y,
-        game_state->ui.cell_type_menu.highlighted_cell_annimation_offset
-      };
+      set_neighbour_state(n[neighbour], (CellNeighbour)(neighbour ^ 1), state);
+    }
+  }
+}
 
-      re_form_world_coord(&highlight_world_pos);
-      vec2 normalised_highlight_pos = world_coord_to_render_window_coord(render_window, highlight_world_pos);
 
-      glPushMatrix();
-        glColor3f(.9, .1, .2); // TODO: Alpha: 0.3
-        glTranslatef(normalised_highlight_pos.x, normalised_highlight_pos.y, 0);
+vec2
+get_direction_cell_direction(CellType type)
+{
+  vec2 result = {0, 0};
 
-        draw_box_outline(Vec2(cell_radius, cell_radius), 0.3);
-      glPopMatrix();
-    }
-    else
-    {
-      game_state->ui.cell_type_menu.highlighted_cell_annimation_offset = (vec2){-1, -1};
-    }
-  }
-  else
+  switch (type)
   {
-    recursively_draw_tree_blocks(game_state, render_window, tree);
+    case CELL_UP:
+    case CELL_UP_UNLESS_DETECT:
+      result = UP;
+      break;
+    case CELL_DOWN:
+    case CELL_DOWN_UNLESS_DETECT:
+      result = DOWN;
+      break;
+    case CELL_LEFT:
+    case CELL_LEFT_UNLESS_DETECT:
+      result = LEFT;
+      break;
+    case CELL_RIGHT:
+    case CELL_RIGHT_UNLESS_DETECT:
+      result = RIGHT;
+      break;
+
+    default: break;
   }
+
+  return result;
 }
\ No newline at end of file
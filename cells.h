@@ -1,16 +1,3 @@
-enum CellDisplayType
-{
-  DISP_TYPE_ENCLOSED,
-  DISP_TYPE_SINGLE,
-  DISP_TYPE_L,
-  DISP_TYPE_STRAIGHT,
-  DISP_TYPE_T,
-  DISP_TYPE_CROSS,
-
-  N_DISP_TYPES
-};
-
-
 enum CellConnectedState
 {
   WALKABLE,
@@ -19,23 +6,20 @@ enum CellConnectedState
 };
 
 
-struct CellBitmaps
-{
-  Bitmap walkable[N_DISP_TYPES];
-  Bitmap unwalkable[N_DISP_TYPES];
-  Bitmap arrow;
-  Bitmap splitter;
-};
+CellConnectedState
+get_neighbour_state(Cell *cell, CellNeighbour neighbour);
 
+CellNeighbour
+get_direction_neighbour(vec2 direction);
 
-struct CellDisplay
-{
-  Bitmap *bitmap;
-  Bitmap *bitmap_overlay;
-  u32 rotate;
-  vec4 color;
-};
+void
+set_cell_type(Maze *maze, Cell *cell, u32 cell_x, u32 cell_y, CellType type, Memory *memory = 0);
 
+void
+link_chunk_cell_neighbours(Maze *maze, CellChunk *chunk);
+
+void
+link_chunk_edges_to_row_runs(Maze *maze, CellChunk *chunk);
 
 void
-draw_cell(CellType type, vec2 world_pos, u32 cell_radius, b32 hovered, CellBitmaps *cell_bitmaps, CellDisplay *cell_display = 0);
+link_all_cell_neighbours(Maze *maze);
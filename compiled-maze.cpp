@@ -0,0 +1,242 @@
+u64
+align_compiled_maze_offset(u64 offset)
+{
+  u64 result = (offset + COMPILED_MAZE_ALIGNMENT - 1) & ~(u64)(COMPILED_MAZE_ALIGNMENT - 1);
+  return result;
+}
+
+
+b32
+is_compiled_maze(const u8 *data, size_t size)
+{
+  b32 result = (size >= sizeof(COMPILED_MAZE_MAGIC) &&
+                memcmp(data, COMPILED_MAZE_MAGIC, sizeof(COMPILED_MAZE_MAGIC)) == 0);
+  return result;
+}
+
+
+// Returns the header if the compiled maze can be used by this build
+const CompiledMazeHeader *
+check_compiled_maze(const u8 *data, size_t size)
+{
+  const CompiledMazeHeader *result = 0;
+  const CompiledMazeHeader *header = (const CompiledMazeHeader *)data;
+
+  if (size < sizeof(CompiledMazeHeader))
+  {
+    printf("Error: Compiled maze is truncated.\n");
+  }
+  else if (header->version != COMPILED_MAZE_VERSION ||
+           header->functions_size != sizeof(Functions) ||
+           header->cell_chunk_size != sizeof(CellChunk) ||
+           header->cell_chunk_size_bits != CELL_CHUNK_SIZE_BITS ||
+           header->maze_stats_size != sizeof(MazeStats))
+  {
+    printf("Error: Compiled maze is from a different version, it needs compiling again.\n");
+  }
+  else if (header->file_size != size ||
+           header->functions_offset + sizeof(Functions) > size ||
+           header->chunks_offset + (u64)header->n_chunks * sizeof(CellChunk) > size)
+  {
+    printf("Error: Compiled maze is truncated.\n");
+  }
+  else
+  {
+    result = header;
+  }
+
+  return result;
+}
+
+
+void
+use_compiled_maze(Maze *maze, Functions *functions, Memory *memory, const CompiledMazeHeader *header, CellChunk *chunks)
+{
+  clear_maze(maze);
+
+  memcpy(functions, (const u8 *)header + header->functions_offset, sizeof(Functions));
+  add_filled_chunks(maze, memory, chunks, header->n_chunks);
+  maze->stats = header->maze_stats;
+
+  // NOTE: The indices aren't in the file, they are found from the chunks
+  //         when they are first needed.
+  maze->type_indices_stale = true;
+
+  log(L_Parser, u8("Loaded compiled maze with %u chunks"), header->n_chunks);
+}
+
+
+// Compiled mazes are used in place in the file's mapping
+b32
+load_mapped_maze_file(Maze *maze, Functions *functions, Memory *memory, const u8 *filename, ParseThreads *parse_threads = 0)
+{
+  File file;
+  b32 success = open_file(filename, &file, false, -1, true);
+  if (success)
+  {
+    if (is_compiled_maze(file.text, file.size))
+    {
+      const CompiledMazeHeader *header = check_compiled_maze(file.text, file.size);
+      if (header)
+      {
+        use_compiled_maze(maze, functions, memory, header, (CellChunk *)(file.write + header->chunks_offset));
+
+        // NOTE: The maze's chunks are in the mapping, so like the arena
+        //         it is never unmapped.
+        close(file.fd);
+      }
+      else
+      {
+        success = false;
+        close_file(&file);
+      }
+    }
+    else
+    {
+      parse(maze, functions, memory, file.text, file.size, parse_threads);
+      close_file(&file);
+    }
+  }
+
+  return success;
+}
+
+
+// Loads either a text or a compiled maze, text mazes too big to map
+//   are streamed.
+b32
+load_maze_file(Maze *maze, Functions *functions, Memory *memory, const u8 *filename, ParseThreads *parse_threads = 0)
+{
+  StreamedFile streamed_file;
+  b32 success = open_streamed_file(filename, &streamed_file);
+  if (success)
+  {
+    if (streamed_file.size <= MAX_MAPPED_MAZE_SIZE)
+    {
+      close_streamed_file(&streamed_file);
+      success = load_mapped_maze_file(maze, functions, memory, filename, parse_threads);
+    }
+    else
+    {
+      // NOTE: Compiled mazes are never written this big
+      u8 magic[sizeof(COMPILED_MAZE_MAGIC)];
+      u32 magic_length = read_streamed_file(&streamed_file, 0, magic, sizeof(magic));
+      if (is_compiled_maze(magic, magic_length))
+      {
+        printf("Error: Compiled maze is too big.\n");
+        success = false;
+      }
+      else
+      {
+        success = parse_streamed(maze, functions, memory, &streamed_file);
+      }
+
+      close_streamed_file(&streamed_file);
+    }
+  }
+
+  return success;
+}
+
+
+// Loads either a text or a compiled maze from the caller's data, the
+//   chunks of a compiled maze are copied into the arena as the data
+//   can't be changed.
+b32
+load_maze_data(Maze *maze, Functions *functions, Memory *memory, const u8 *data, size_t size, ParseThreads *parse_threads = 0)
+{
+  b32 success = true;
+
+  if (is_compiled_maze(data, size))
+  {
+    const CompiledMazeHeader *header = check_compiled_maze(data, size);
+    if (header)
+    {
+      CellChunk *chunks = push_structs(memory, CellChunk, header->n_chunks);
+      memcpy(chunks, data + header->chunks_offset, header->n_chunks * sizeof(CellChunk));
+
+      use_compiled_maze(maze, functions, memory, header, chunks);
+    }
+    else
+    {
+      success = false;
+    }
+  }
+  else
+  {
+    parse(maze, functions, memory, data, size, parse_threads);
+  }
+
+  return success;
+}
+
+
+b32
+write_compiled_maze(Maze *maze, Functions *functions, const u8 *filename)
+{
+  b32 success = true;
+
+  u64 functions_offset = align_compiled_maze_offset(sizeof(CompiledMazeHeader));
+  u64 chunks_offset = align_compiled_maze_offset(functions_offset + sizeof(Functions));
+  u64 file_size = chunks_offset + (u64)maze->n_chunks * sizeof(CellChunk);
+
+  // NOTE: Files are mapped with an s32 size
+  if (file_size > MAX_S32)
+  {
+    printf("Error: Maze is too big to compile.\n");
+    success = false;
+  }
+  else if (maze->row_runs && maze->row_runs->n_runs)
+  {
+    printf("Error: Mazes stored as row runs can't be compiled.\n");
+    success = false;
+  }
+  else
+  {
+    File file;
+    success = open_file(filename, &file, true, file_size);
+    if (success)
+    {
+      CompiledMazeHeader *header = (CompiledMazeHeader *)file.write;
+      memcpy(header->magic, COMPILED_MAZE_MAGIC, sizeof(COMPILED_MAZE_MAGIC));
+      header->version = COMPILED_MAZE_VERSION;
+      header->functions_size = sizeof(Functions);
+      header->cell_chunk_size = sizeof(CellChunk);
+      header->cell_chunk_size_bits = CELL_CHUNK_SIZE_BITS;
+      header->maze_stats_size = sizeof(MazeStats);
+      header->n_chunks = maze->n_chunks;
+      header->functions_offset = functions_offset;
+      header->chunks_offset = chunks_offset;
+      header->file_size = file_size;
+
+      // NOTE: Any stale bounds are found now so the loaded maze's are
+      //         exact.
+      get_maze_bounds(maze);
+      header->maze_stats = maze->stats;
+
+      memcpy(file.write + functions_offset, functions, sizeof(Functions));
+
+      CellChunk *compiled_chunk = (CellChunk *)(file.write + chunks_offset);
+      CellChunk *chunk = maze->first_chunk;
+      while (chunk)
+      {
+        *compiled_chunk = *chunk;
+        compiled_chunk->next_chunk = 0;
+        compiled_chunk->active_tick = 0;
+        compiled_chunk->next_active_chunk = 0;
+        compiled_chunk->dirty = false;
+        zero_n(compiled_chunk->cell_dirty, u32, CELLS_PER_CHUNK / 32);
+        compiled_chunk->next_dirty_chunk = 0;
+
+        ++compiled_chunk;
+        chunk = chunk->next_chunk;
+      }
+
+      close_file(&file);
+
+      log(L_Serializer, u8("Compiled maze with %u chunks"), maze->n_chunks);
+    }
+  }
+
+  return success;
+}
\ No newline at end of file
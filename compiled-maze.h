@@ -0,0 +1,38 @@
+// Compiled mazes are the sim's maze written out as it is in memory, so
+//   the file can be mapped and used in place instead of being parsed:
+// - CompiledMazeHeader, with the maze's stats in it
+// - The Functions table
+// - The maze's cell chunks, in chain order, with the cells' neighbour
+//     states already linked, and the chunk links zeroed. Mazes are
+//     compiled after order_maze_chunks(), so the chunks are in Morton
+//     order and are used where they are mapped.
+//
+// The header has the sizes of the structs in it, a file written by a
+//   build with a different layout is rejected and has to be compiled
+//   again from the text.
+
+const u8 COMPILED_MAZE_MAGIC[4] = {0x7f, 'M', 'Z', 'C'};
+const u32 COMPILED_MAZE_VERSION = 4;
+
+// NOTE: Sections start on cache lines, the mapping itself is page
+//         aligned.
+const u32 COMPILED_MAZE_ALIGNMENT = 64;
+
+
+struct CompiledMazeHeader
+{
+  u8 magic[4];
+  u32 version;
+
+  u32 functions_size;
+  u32 cell_chunk_size;
+  u32 cell_chunk_size_bits;
+  u32 maze_stats_size;
+  u32 n_chunks;
+
+  u64 functions_offset;
+  u64 chunks_offset;
+  u64 file_size;
+
+  MazeStats maze_stats;
+};
\ No newline at end of file
@@ -0,0 +1,261 @@
+CorridorRun *
+find_corridor_run(Corridors *corridors, u32 x, u32 y, u8 direction)
+{
+  CorridorRun *result = 0;
+
+  if (corridors->n_runs)
+  {
+    u32 slot = get_cell_direction_hash_slot(x, y, direction, corridors->hash_size);
+    while (corridors->runs[slot].length)
+    {
+      CorridorRun *run = corridors->runs + slot;
+      if (run->start_x == x &&
+          run->start_y == y &&
+          run->start_direction == direction)
+      {
+        result = run;
+        break;
+      }
+      slot = (slot + 1) & (corridors->hash_size - 1);
+    }
+  }
+
+  return result;
+}
+
+
+b32
+is_corridor_cell(Cell *cell)
+{
+  b32 result = cell && cell->is_corridor;
+  return result;
+}
+
+
+void
+mark_corridor_cells(Maze *maze, Memory *memory)
+{
+  CellsIterator iter = {};
+  Cell *cell;
+  while ((cell = cells_iterator(maze, &iter)))
+  {
+    cell->is_corridor = cell->type == CELL_PATH;
+  }
+
+  const CellType breaking_types[] = {
+    CELL_ONCE,
+    CELL_UP_UNLESS_DETECT,
+    CELL_DOWN_UNLESS_DETECT,
+    CELL_LEFT_UNLESS_DETECT,
+    CELL_RIGHT_UNLESS_DETECT
+  };
+
+  for (u32 type_index = 0;
+       type_index < array_count(breaking_types);
+       ++type_index)
+  {
+    CellTypeIndex *index = get_cell_type_index(maze, breaking_types[type_index], memory);
+    for (u32 position_index = 0;
+         position_index < index->n_positions;
+         ++position_index)
+    {
+      CellPosition *position = index->positions + position_index;
+
+      Cell *n[N_CELL_NEIGHBOURS];
+      directly_neighbouring_cells(n, maze, position->x, position->y);
+
+      for (u32 neighbour = 0;
+           neighbour < N_CELL_NEIGHBOURS;
+           ++neighbour)
+      {
+        if (n[neighbour])
+        {
+          n[neighbour]->is_corridor = false;
+        }
+      }
+    }
+  }
+}
+
+
+// Moves the position one cell in direction, and returns the cell there
+Cell *
+get_neighbour_cell(Maze *maze, u32 *cell_x, u32 *cell_y, CarDirection direction)
+{
+  vec2 direction_vector = CAR_DIRECTION_VECTORS[direction];
+  *cell_x += (s32)direction_vector.x;
+  *cell_y += (s32)direction_vector.y;
+
+  Cell *result = get_cell(maze, *cell_x, *cell_y);
+  return result;
+}
+
+
+// Gets the corridor cell a car would enter moving off cell in direction,
+//   or 0 if it doesn't enter a corridor.
+Cell *
+get_corridor_entry(Maze *maze, Cell *cell, u32 cell_x, u32 cell_y, CarDirection direction, u32 *entry_x, u32 *entry_y)
+{
+  Cell *result = 0;
+
+  if (get_neighbour_state(cell, (CellNeighbour)direction) == WALKABLE)
+  {
+    *entry_x = cell_x;
+    *entry_y = cell_y;
+    Cell *neighbour = get_neighbour_cell(maze, entry_x, entry_y, direction);
+    if (is_corridor_cell(neighbour))
+    {
+      result = neighbour;
+    }
+  }
+
+  return result;
+}
+
+
+void
+follow_corridor(Maze *maze, u32 start_x, u32 start_y, CarDirection direction, CorridorRun *run)
+{
+  run->start_x = start_x;
+  run->start_y = start_y;
+  run->start_direction = direction;
+
+  u32 x = start_x;
+  u32 y = start_y;
+  Cell *cell = get_cell(maze, x, y);
+  u32 length = 0;
+
+  while (length < MAX_CORRIDOR_RUN_LENGTH &&
+         is_corridor_cell(cell))
+  {
+    // NOTE: A car can always turn back the way it came, so it can't
+    //         get stuck in a corridor.
+    b32 can_move = get_car_move(cell, direction, &direction);
+    assert(can_move);
+
+    cell = get_neighbour_cell(maze, &x, &y, direction);
+    ++length;
+  }
+
+  run->end_x = x;
+  run->end_y = y;
+  run->end_direction = direction;
+  run->length = length;
+}
+
+
+void
+insert_corridor_run_into_hash(CorridorRun *runs, u32 hash_size, CorridorRun *run)
+{
+  u32 slot = get_cell_direction_hash_slot(run->start_x, run->start_y, run->start_direction, hash_size);
+  while (runs[slot].length)
+  {
+    slot = (slot + 1) & (hash_size - 1);
+  }
+  runs[slot] = *run;
+}
+
+
+void
+grow_corridor_hash(Memory *memory, Corridors *corridors)
+{
+  u32 new_hash_size = corridors->hash_size ? 2 * corridors->hash_size : INITIAL_CORRIDOR_HASH_SIZE;
+  log(L_Corridors, u8("Growing corridor hash to %u slots"), new_hash_size);
+
+  // NOTE: The old table is left in the arena, like the chunk hash.
+  CorridorRun *new_runs = push_structs(memory, CorridorRun, new_hash_size);
+  zero_n(new_runs, CorridorRun, new_hash_size);
+
+  for (u32 slot = 0;
+       slot < corridors->hash_size;
+       ++slot)
+  {
+    CorridorRun *old_run = corridors->runs + slot;
+    if (old_run->length)
+    {
+      insert_corridor_run_into_hash(new_runs, new_hash_size, old_run);
+    }
+  }
+
+  corridors->runs = new_runs;
+  corridors->hash_size = new_hash_size;
+}
+
+
+void
+add_corridor_run(Memory *memory, Corridors *corridors, CorridorRun *run)
+{
+  if (2 * (corridors->n_runs + 1) > corridors->hash_size)
+  {
+    grow_corridor_hash(memory, corridors);
+  }
+
+  insert_corridor_run_into_hash(corridors->runs, corridors->hash_size, run);
+  ++corridors->n_runs;
+}
+
+
+void
+analyse_corridors(Memory *memory, Corridors *corridors, Maze *maze)
+{
+  if (corridors->runs)
+  {
+    zero_n(corridors->runs, CorridorRun, corridors->hash_size);
+  }
+  corridors->n_runs = 0;
+
+  mark_corridor_cells(maze, memory);
+
+  u64 total_length = 0;
+
+  CellsIterator iter = {};
+  Cell *cell;
+  while ((cell = cells_iterator(maze, &iter)))
+  {
+    // Runs are entered from any cell a car can be on, other than
+    //   corridor cells.
+    if (cell_walkable(cell->type) != WALKABLE ||
+        is_corridor_cell(cell))
+    {
+      continue;
+    }
+
+    for (u32 direction = 0;
+         direction < N_CELL_NEIGHBOURS;
+         ++direction)
+    {
+      u32 entry_x;
+      u32 entry_y;
+      Cell *entry = get_corridor_entry(maze, cell, iter.x, iter.y, (CarDirection)direction, &entry_x, &entry_y);
+      CarDirection entry_direction = (CarDirection)direction;
+
+      // NOTE: Several cells can enter the same run, e.g. either side
+      //         of a cross roads.
+      while (entry &&
+             !find_corridor_run(corridors, entry_x, entry_y, entry_direction))
+      {
+        CorridorRun run;
+        follow_corridor(maze, entry_x, entry_y, entry_direction, &run);
+        add_corridor_run(memory, corridors, &run);
+        total_length += run.length;
+
+        entry = 0;
+
+        Cell *end = get_cell(maze, run.end_x, run.end_y);
+        if (is_corridor_cell(end))
+        {
+          // The run was cut off at MAX_CORRIDOR_RUN_LENGTH, carry on
+          //   from the next move so long corridors and loops stay
+          //   compressed.
+          b32 can_move = get_car_move(end, (CarDirection)run.end_direction, &entry_direction);
+          assert(can_move);
+          entry_x = run.end_x;
+          entry_y = run.end_y;
+          entry = get_neighbour_cell(maze, &entry_x, &entry_y, entry_direction);
+        }
+      }
+    }
+  }
+
+  log(L_Corridors, u8("Found %u corridor runs, %lu cells total"), corridors->n_runs, total_length);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+// Corridor compression
+//
+// Most cells are plain CELL_PATH corridors where a car does nothing but
+//   move. When the maze is loaded, every run of corridor cells a car can
+//   enter is followed to the next "interesting" cell, and stored in a
+//   hash keyed by the cell and direction the car enters it with.
+//
+// A car entering a run jumps straight to the end of it, and then sits
+//   in transit (skip_ticks) for the number of ticks it would have taken
+//   to get there, so the tick numbering and outputs don't change.
+//
+// A cell is only a corridor cell if nothing can see or change the
+//   car's path through it:
+// - It is a CELL_PATH
+// - None of its neighbours are unless-detect cells, which would see the car
+// - None of its neighbours are ONCE cells, which would change its neighbour states
+
+
+// NOTE: Longer runs, and runs going round a closed loop of corridor
+//         cells, are split into several runs of this length.
+const u32 MAX_CORRIDOR_RUN_LENGTH = MAX_U16;
+
+const u32 INITIAL_CORRIDOR_HASH_SIZE = 1024;
+
+
+struct CorridorRun
+{
+  u32 start_x;
+  u32 start_y;
+  u32 end_x;
+  u32 end_y;
+
+  // NOTE: A length of 0 marks an empty hash slot.
+  u16 length;
+  u8 start_direction;
+  u8 end_direction;
+};
+
+
+struct Corridors
+{
+  b32 enabled;
+
+  // Open addressed hash table
+  CorridorRun *runs;
+  u32 hash_size;
+  u32 n_runs;
+};
+
+
+CorridorRun *
+find_corridor_run(Corridors *corridors, u32 x, u32 y, u8 direction);
@@ -1,12 +1,3 @@
-u64
-get_us()
-{
-  struct timeval tv;
-  gettimeofday(&tv, 0);
-  return ((u64)tv.tv_sec * (u64)1000000) + (u64)tv.tv_usec;
-}
-
-
 void
 set_keys(Keys *keys)
 {
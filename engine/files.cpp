@@ -1,5 +1,7 @@
+// private_write maps a file read only as copy-on-write, so it can be
+//   changed in memory without changing the file.
 b32
-open_file(const u8 *filename, File *result, b32 write = false, s32 trunc_to = -1)
+open_file(const u8 *filename, File *result, b32 write = false, s32 trunc_to = -1, b32 private_write = false)
 {
   b32 success = true;
 
@@ -8,10 +10,16 @@ open_file(const u8 *filename, File *result, b32 write = false, s32 trunc_to = -1
   s32 mmap_prot;
   if (write)
   {
-    open_flags = O_RDWR | O_TRUNC;
+    open_flags = O_RDWR | O_CREAT | O_TRUNC;
     mmap_prot = PROT_READ | PROT_WRITE;
     mmap_flags = MAP_SHARED;
   }
+  else if (private_write)
+  {
+    open_flags = O_RDONLY;
+    mmap_prot = PROT_READ | PROT_WRITE;
+    mmap_flags = MAP_PRIVATE;
+  }
   else
   {
     open_flags = O_RDONLY;
@@ -19,7 +27,7 @@ open_file(const u8 *filename, File *result, b32 write = false, s32 trunc_to = -1
     mmap_flags = MAP_PRIVATE;
   }
 
-  result->fd = open((const char *)filename, open_flags);
+  result->fd = open((const char *)filename, open_flags, 0644);
   if (result->fd == -1)
   {
     printf("Failed to open file: \"%s\"\n", filename);
@@ -62,7 +70,7 @@ open_file(const u8 *filename, File *result, b32 write = false, s32 trunc_to = -1
       {
         result->text = file_ptr;
 
-        if (write)
+        if (write || private_write)
         {
           result->write = (u8 *)file_ptr;
         }
@@ -114,4 +122,120 @@ close_file(File *file, s32 trunc_to = -1)
   }
 
   return error;
+}
+
+
+b32
+stat_streamed_file(StreamedFile *file)
+{
+  b32 success = true;
+
+  struct stat sb;
+  if (fstat(file->fd, &sb) == -1)
+  {
+    success = false;
+  }
+  else
+  {
+    file->size = sb.st_size;
+    file->modified_ns = (u64)sb.st_mtim.tv_sec * 1000000000 + sb.st_mtim.tv_nsec;
+  }
+
+  return success;
+}
+
+
+b32
+open_streamed_file(const u8 *filename, StreamedFile *result, StreamedFileMode mode = STREAMED_FILE_READ)
+{
+  b32 success = true;
+
+  s32 open_flags;
+  switch (mode)
+  {
+    case STREAMED_FILE_WRITE:  open_flags = O_WRONLY | O_CREAT | O_TRUNC;  break;
+    case STREAMED_FILE_CHANGE: open_flags = O_RDWR;                        break;
+    default:                   open_flags = O_RDONLY;                      break;
+  }
+
+  result->fd = open((const char *)filename, open_flags, 0644);
+  if (result->fd == -1)
+  {
+    printf("Failed to open file: \"%s\"\n", filename);
+    success = false;
+  }
+  else if (!stat_streamed_file(result))
+  {
+    printf("Failed to fstat : \"%s\"\n", filename);
+    close(result->fd);
+    result->fd = -1;
+    success = false;
+  }
+  else if (mode == STREAMED_FILE_READ)
+  {
+    posix_fadvise(result->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  return success;
+}
+
+
+// Reads up to size bytes from offset, returns the number of bytes read,
+//   which is only less than size at the end of the file.
+u32
+read_streamed_file(StreamedFile *file, u64 offset, u8 *buffer, u32 size)
+{
+  u32 bytes_read = 0;
+
+  while (bytes_read < size)
+  {
+    ssize_t result = pread(file->fd, buffer + bytes_read, size - bytes_read, offset + bytes_read);
+    if (result <= 0)
+    {
+      if (result < 0)
+      {
+        printf("Error reading file.\n");
+      }
+      break;
+    }
+    bytes_read += result;
+  }
+
+  return bytes_read;
+}
+
+
+b32
+write_streamed_file(StreamedFile *file, u64 offset, const u8 *data, u32 size)
+{
+  b32 success = true;
+
+  u32 bytes_written = 0;
+  while (bytes_written < size)
+  {
+    ssize_t result = pwrite(file->fd, data + bytes_written, size - bytes_written, offset + bytes_written);
+    if (result < 0)
+    {
+      printf("Error writing file.\n");
+      success = false;
+      break;
+    }
+    bytes_written += result;
+  }
+  if (offset + bytes_written > file->size)
+  {
+    file->size = offset + bytes_written;
+  }
+
+  return success;
+}
+
+
+void
+close_streamed_file(StreamedFile *file)
+{
+  if (close(file->fd) != 0)
+  {
+    printf("Error while closing file descriptor.\n");
+  }
 }
\ No newline at end of file
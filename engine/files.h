@@ -5,3 +5,20 @@ struct File
   u8 *write;
   s32 size;
 };
+
+
+// Files which are too big to map are read or written a block at a time
+struct StreamedFile
+{
+  s32 fd;
+  u64 size;
+  u64 modified_ns;
+};
+
+
+enum StreamedFileMode
+{
+  STREAMED_FILE_READ,
+  STREAMED_FILE_WRITE,
+  STREAMED_FILE_CHANGE  // Write without truncating
+};
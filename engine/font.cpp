@@ -37,30 +37,3 @@ draw_string(Bitmap *font, vec2 world_pos, const u8 str[], r32 scale = 1, vec4 co
     ++i;
   }
 }
-
-
-u32
-formatted_string(u8 *out, u32 max_len, const u8 *pattern,  ...)
-{
-  u32 result;
-
-  va_list aptr;
-  va_start(aptr, pattern);
-  s32 written = vsnprintf((char *)out, max_len, (const char *)pattern, aptr);
-  va_end(aptr);
-
-  if (written >= 0 && written <= max_len)
-  {
-    result = (u32)written;
-  }
-  else if (written > max_len)
-  {
-    result = max_len;
-  }
-  else
-  {
-    result = 0;
-  }
-
-  return result;
-}
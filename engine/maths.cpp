@@ -18,6 +18,26 @@ min(u32 a, u32 b)
   }
   return result;
 }
+s64
+min(s64 a, s64 b)
+{
+  s64 result = a;
+  if (b < a)
+  {
+    result = b;
+  }
+  return result;
+}
+u64
+min(u64 a, u64 b)
+{
+  u64 result = a;
+  if (b < a)
+  {
+    result = b;
+  }
+  return result;
+}
 r32
 min(r32 a, r32 b)
 {
@@ -49,6 +69,26 @@ max(u32 a, u32 b)
   }
   return result;
 }
+s64
+max(s64 a, s64 b)
+{
+  s64 result = a;
+  if (b > a)
+  {
+    result = b;
+  }
+  return result;
+}
+u64
+max(u64 a, u64 b)
+{
+  u64 result = a;
+  if (b > a)
+  {
+    result = b;
+  }
+  return result;
+}
 r32
 max(r32 a, r32 b)
 {
@@ -92,4 +92,13 @@ to_little_endian(s32 big)
   result[3] = bytes[0];
 
   return *(s32 *)result;
+}
+
+
+u64
+get_us()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return ((u64)tv.tv_sec * (u64)1000000) + (u64)tv.tv_usec;
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+// libmazesim: The simulation as a static library, with only the parts
+//   of the engine it needs, so it doesn't depend on SDL or OpenGL.
+//
+// Built with: make libmazesim
+//
+// Users only need mazesim-api.h.
+
+#define DEBUG
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "engine/utils.h"
+#include "engine/platform.h"
+#include "engine/files.h"
+#include "engine/print.h"
+#include "engine/text.h"
+#include "engine/logging.h"
+#include "engine/maths.h"
+#include "engine/vectors.h"
+#include "engine/string.h"
+
+#include "engine/utils.cpp"
+#include "engine/platform.cpp"
+#include "engine/files.cpp"
+#include "engine/print.cpp"
+#include "engine/text.cpp"
+#include "engine/logging.cpp"
+#include "engine/maths.cpp"
+#include "engine/vectors.cpp"
+#include "engine/string.cpp"
+
+#include "mazesim.h"
+#include "mazesim-api.h"
+
+#include "mazesim.cpp"
+#include "mazesim-api.cpp"
\ No newline at end of file
@@ -5,7 +5,11 @@ channel_enabled(GAMELoggingChannel channel)
   {
     case L_CarsStorage:
     case L_CarsSim:
+    case L_SimThreads:
     case L_CellsStorage:
+    case L_Corridors:
+    case L_Loops:
+    case L_Reachability:
     case L_Cells:
     case L_Parser:
     case L_Serializer:
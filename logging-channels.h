@@ -1,7 +1,11 @@
 #define GAME_LOGGING_CHANNELS(CHANNEL) \
           CHANNEL(L_CarsStorage) \
           CHANNEL(L_CarsSim) \
+          CHANNEL(L_SimThreads) \
           CHANNEL(L_CellsStorage) \
+          CHANNEL(L_Corridors) \
+          CHANNEL(L_Loops) \
+          CHANNEL(L_Reachability) \
           CHANNEL(L_Cells) \
           CHANNEL(L_Parser) \
           CHANNEL(L_Serializer) \
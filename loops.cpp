@@ -0,0 +1,476 @@
+b32
+is_loop_cell(Maze *maze, Functions *functions, Cell *cell, u32 cell_x, u32 cell_y)
+{
+  b32 result = false;
+
+  if (cell)
+  {
+    switch (cell->type)
+    {
+      case (CELL_START):
+      case (CELL_PATH):
+      case (CELL_UP):
+      case (CELL_DOWN):
+      case (CELL_LEFT):
+      case (CELL_RIGHT):
+      {
+        result = true;
+      } break;
+
+      case (CELL_FUNCTION):
+      {
+        Function *function = functions->hash_table + cell->function_index;
+        switch (function->type)
+        {
+          case (FUNCTION_ASSIGNMENT):
+          case (FUNCTION_MULTIPLY):
+          case (FUNCTION_DIVIDE):
+          {
+            result = false;
+          } break;
+
+          default:
+          {
+            result = true;
+          } break;
+        }
+      } break;
+
+      default: break;
+    }
+  }
+
+  if (result)
+  {
+    Cell *n[N_CELL_NEIGHBOURS];
+    directly_neighbouring_cells(n, maze, cell_x, cell_y);
+
+    for (u32 neighbour = 0;
+         neighbour < N_CELL_NEIGHBOURS;
+         ++neighbour)
+    {
+      if (n[neighbour])
+      {
+        switch (n[neighbour]->type)
+        {
+          case (CELL_ONCE):
+          case (CELL_UP_UNLESS_DETECT):
+          case (CELL_DOWN_UNLESS_DETECT):
+          case (CELL_LEFT_UNLESS_DETECT):
+          case (CELL_RIGHT_UNLESS_DETECT):
+          {
+            result = false;
+          } break;
+
+          default: break;
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+
+b32
+is_conditional_function(Function *function)
+{
+  b32 result = false;
+
+  switch (function->type)
+  {
+    case (FUNCTION_LESS):
+    case (FUNCTION_LESS_EQUAL):
+    case (FUNCTION_EQUAL):
+    case (FUNCTION_NOT_EQUAL):
+    case (FUNCTION_GREATER_EQUAL):
+    case (FUNCTION_GREATER):
+    {
+      result = true;
+    } break;
+
+    default: break;
+  }
+
+  return result;
+}
+
+
+b32
+evaluate_conditional(Function *function, s64 value)
+{
+  b32 result = false;
+  s64 conditional_value = function->conditional.value;
+
+  switch (function->type)
+  {
+    case (FUNCTION_LESS):
+      result = value < conditional_value;
+      break;
+    case (FUNCTION_LESS_EQUAL):
+      result = value <= conditional_value;
+      break;
+    case (FUNCTION_EQUAL):
+      result = value == conditional_value;
+      break;
+    case (FUNCTION_NOT_EQUAL):
+      result = value != conditional_value;
+      break;
+    case (FUNCTION_GREATER_EQUAL):
+      result = value >= conditional_value;
+      break;
+    case (FUNCTION_GREATER):
+      result = value > conditional_value;
+      break;
+    default: break;
+  }
+
+  return result;
+}
+
+
+// Walks one lap from a car arriving at anchor, following the same rules
+//   as car_cell_interactions() and move_car(). Returns false if the car
+//   doesn't come back round to the anchor in the same direction.
+b32
+measure_car_loop(Maze *maze, Functions *functions, u32 anchor_x, u32 anchor_y, CarDirection arrival_direction, s32 value, CarLoop *loop)
+{
+  b32 success = true;
+
+  loop->length = 0;
+  loop->value_change = 0;
+  loop->min_value_offset = 0;
+  loop->max_value_offset = 0;
+  loop->n_conditionals = 0;
+
+  u32 x = anchor_x;
+  u32 y = anchor_y;
+  Cell *anchor = get_cell(maze, x, y);
+  Cell *cell = anchor;
+  CarDirection direction = arrival_direction;
+  s64 value_offset = 0;
+
+  while (success)
+  {
+    if (!is_loop_cell(maze, functions, cell, x, y))
+    {
+      success = false;
+      break;
+    }
+
+    switch (cell->type)
+    {
+      case (CELL_UP):
+      case (CELL_DOWN):
+      case (CELL_LEFT):
+      case (CELL_RIGHT):
+      {
+        direction = get_car_direction_from_vector(get_direction_cell_direction(cell->type));
+      } break;
+
+      case (CELL_FUNCTION):
+      {
+        Function *function = functions->hash_table + cell->function_index;
+
+        if (function->type == FUNCTION_INCREMENT)
+        {
+          value_offset += function->value;
+        }
+        else if (function->type == FUNCTION_DECREMENT)
+        {
+          value_offset -= function->value;
+        }
+        else if (is_conditional_function(function))
+        {
+          if (loop->n_conditionals == MAX_LOOP_CONDITIONALS)
+          {
+            success = false;
+            break;
+          }
+
+          LoopConditional *conditional = loop->conditionals + loop->n_conditionals++;
+          conditional->function = function;
+          conditional->value_offset = value_offset;
+          conditional->outcome = evaluate_conditional(function, value + value_offset);
+
+          if (conditional->outcome)
+          {
+            direction = get_car_direction_from_vector(function->conditional.true_direction);
+          }
+          else if (function->conditional.else_exists)
+          {
+            direction = get_car_direction_from_vector(function->conditional.false_direction);
+          }
+        }
+      } break;
+
+      default: break;
+    }
+
+    // NOTE: The serial sim works on s32 values, stop rather than
+    //         reproduce overflow.
+    if (value + value_offset > MAX_S32 ||
+        value + value_offset < MIN_S32)
+    {
+      success = false;
+      break;
+    }
+
+    loop->min_value_offset = min(loop->min_value_offset, value_offset);
+    loop->max_value_offset = max(loop->max_value_offset, value_offset);
+
+    if (!get_car_move(cell, direction, &direction))
+    {
+      success = false;
+      break;
+    }
+
+    cell = get_neighbour_cell(maze, &x, &y, direction);
+    ++loop->length;
+
+    if (cell == anchor && direction == arrival_direction)
+    {
+      break;
+    }
+    else if (loop->length == MAX_LOOP_LENGTH)
+    {
+      success = false;
+    }
+  }
+
+  loop->value_change = value_offset;
+
+  return success;
+}
+
+
+s64
+ceil_divide(s64 numerator, s64 denominator)
+{
+  s64 result = (numerator + denominator - 1) / denominator;
+  return result;
+}
+
+
+// Gets the first lap in which the conditional gives a different
+//   outcome, or MAX_U32 if it never does.
+u64
+get_conditional_change_lap(LoopConditional *conditional, s64 start_value, s64 value_change)
+{
+  u64 result = MAX_U32;
+
+  Function *function = conditional->function;
+  s64 value = start_value + conditional->value_offset;
+
+  if (value_change != 0)
+  {
+    switch (function->type)
+    {
+      case (FUNCTION_EQUAL):
+      case (FUNCTION_NOT_EQUAL):
+      {
+        s64 difference = function->conditional.value - value;
+        if (difference == 0)
+        {
+          // Equal now, so not equal next lap
+          result = 1;
+        }
+        else if (difference % value_change == 0 &&
+                 difference / value_change > 0)
+        {
+          result = difference / value_change;
+        }
+      } break;
+
+      default:
+      {
+        // The rest are all (value - conditional_value) < threshold,
+        //   maybe negated, which changes at most once as the value only
+        //   moves one way.
+        s64 threshold = 0;
+        if (function->type == FUNCTION_LESS_EQUAL ||
+            function->type == FUNCTION_GREATER)
+        {
+          threshold = 1;
+        }
+
+        s64 distance = value - function->conditional.value;
+        b32 below = distance < threshold;
+
+        if (below && value_change > 0)
+        {
+          result = ceil_divide(threshold - distance, value_change);
+        }
+        else if (!below && value_change < 0)
+        {
+          result = ceil_divide(distance - threshold + 1, -value_change);
+        }
+      } break;
+    }
+  }
+
+  return result;
+}
+
+
+// Gets the number of laps which will be exactly the same as the one
+//   measured.
+u64
+get_repeated_laps(CarLoop *loop, s32 value)
+{
+  u64 laps = MAX_U32 / loop->length;
+
+  for (u32 conditional_index = 0;
+       conditional_index < loop->n_conditionals;
+       ++conditional_index)
+  {
+    LoopConditional *conditional = loop->conditionals + conditional_index;
+    laps = min(laps, get_conditional_change_lap(conditional, value, loop->value_change));
+  }
+
+  // Stop before the value would overflow
+  if (loop->value_change > 0)
+  {
+    laps = min(laps, (u64)(((s64)MAX_S32 - value - loop->max_value_offset) / loop->value_change));
+  }
+  else if (loop->value_change < 0)
+  {
+    laps = min(laps, (u64)(((s64)value + loop->min_value_offset - MIN_S32) / -loop->value_change));
+  }
+
+  return laps;
+}
+
+
+void
+insert_loop_attempts_into_hash(LoopAttempts *table, u32 hash_size, LoopAttempts *attempts)
+{
+  u32 slot = get_cell_direction_hash_slot(attempts->cell_x, attempts->cell_y, attempts->direction, hash_size);
+  while (table[slot].used)
+  {
+    slot = (slot + 1) & (hash_size - 1);
+  }
+  table[slot] = *attempts;
+}
+
+
+void
+grow_loop_attempts_hash(Memory *memory, Loops *loops)
+{
+  u32 new_hash_size = loops->hash_size ? 2 * loops->hash_size : INITIAL_LOOP_ATTEMPTS_HASH_SIZE;
+  log(L_Loops, u8("Growing loop attempts hash to %u slots"), new_hash_size);
+
+  // NOTE: The old table is left in the arena, like the chunk hash.
+  LoopAttempts *new_attempts = push_structs(memory, LoopAttempts, new_hash_size);
+  zero_n(new_attempts, LoopAttempts, new_hash_size);
+
+  for (u32 slot = 0;
+       slot < loops->hash_size;
+       ++slot)
+  {
+    LoopAttempts *old_attempts = loops->attempts + slot;
+    if (old_attempts->used)
+    {
+      insert_loop_attempts_into_hash(new_attempts, new_hash_size, old_attempts);
+    }
+  }
+
+  loops->attempts = new_attempts;
+  loops->hash_size = new_hash_size;
+}
+
+
+LoopAttempts *
+find_or_create_loop_attempts(Memory *memory, Loops *loops, u32 x, u32 y, u8 direction)
+{
+  LoopAttempts *result = 0;
+
+  if (2 * (loops->n_attempts + 1) > loops->hash_size)
+  {
+    grow_loop_attempts_hash(memory, loops);
+  }
+
+  u32 slot = get_cell_direction_hash_slot(x, y, direction, loops->hash_size);
+  while (loops->attempts[slot].used)
+  {
+    LoopAttempts *attempts = loops->attempts + slot;
+    if (attempts->cell_x == x &&
+        attempts->cell_y == y &&
+        attempts->direction == direction)
+    {
+      result = attempts;
+      break;
+    }
+    slot = (slot + 1) & (loops->hash_size - 1);
+  }
+
+  if (!result)
+  {
+    result = loops->attempts + slot;
+    zero(result, LoopAttempts);
+    result->cell_x = x;
+    result->cell_y = y;
+    result->direction = direction;
+    result->used = true;
+    ++loops->n_attempts;
+  }
+
+  return result;
+}
+
+
+void
+reset_loops(Loops *loops)
+{
+  if (loops->attempts)
+  {
+    zero_n(loops->attempts, LoopAttempts, loops->hash_size);
+  }
+  loops->n_attempts = 0;
+}
+
+
+// Called for a car which has just been on a conditional function cell,
+//   after arriving at it in arrival_direction.
+void
+accelerate_car_loop(Memory *memory, Loops *loops, Maze *maze, Functions *functions, Car car, CarDirection arrival_direction)
+{
+  u32 cell_x = *car_cell_x(car);
+  u32 cell_y = *car_cell_y(car);
+
+  LoopAttempts *attempts = find_or_create_loop_attempts(memory, loops, cell_x, cell_y, arrival_direction);
+
+  if (attempts->hits_to_skip)
+  {
+    --attempts->hits_to_skip;
+  }
+  else
+  {
+    CarLoop *loop = &loops->scratch_loop;
+    s32 value = *car_value(car);
+
+    u64 laps = 0;
+    if (measure_car_loop(maze, functions, cell_x, cell_y, arrival_direction, value, loop))
+    {
+      laps = get_repeated_laps(loop, value);
+    }
+
+    if (laps)
+    {
+      log(L_Loops, u8("Accelerating car %u through %lu laps of %u ticks"), *car_id(car), laps, loop->length);
+
+      // The car ends up arriving back at the anchor, ready to go round
+      //   the first lap which is different.
+      *car_value(car) = value + (s64)laps * loop->value_change;
+      set_car_direction(car, arrival_direction);
+      *car_skip_ticks(car) = laps * loop->length;
+
+      attempts->failures = 0;
+    }
+    else
+    {
+      attempts->failures = min((u32)attempts->failures + 1, MAX_LOOP_ATTEMPT_BACKOFF);
+      attempts->hits_to_skip = 1 << attempts->failures;
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+// Loop acceleration
+//
+// Counting loops, such as the multiplication demo, send a car round the
+//   same cycle of cells many times, changing its value by the same
+//   amount each lap until a conditional function sends it out.
+//
+// When a car hits a conditional function cell, the lap starting from
+//   that cell is measured by walking it with the car's value. If the car
+//   gets back to the same cell, travelling in the same direction, the
+//   laps are all the same until one of the conditionals along the way
+//   changes its outcome. As the only value changes allowed are
+//   increments and decrements, that lap can be worked out directly.
+//
+// The car then jumps to the state it would be in after those laps, and
+//   sits in transit (skip_ticks) for the ticks they would have taken.
+//
+// A cell can only be part of an accelerated lap if nothing can see the
+//   car on it or change the lap:
+// - Path, start, direction, and function cells, with the function being
+//     an increment, decrement, conditional or undefined
+// - None of its neighbours are unless-detect cells or ONCE cells
+
+
+const u32 MAX_LOOP_LENGTH = 1 << 16;
+const u32 MAX_LOOP_CONDITIONALS = 64;
+
+// NOTE: After a failed attempt the next 2^failures hits on the same cell
+//         are not tried, so cells that are not part of a loop don't
+//         cost a walk for every car passing over them.
+const u32 MAX_LOOP_ATTEMPT_BACKOFF = 16;
+
+const u32 INITIAL_LOOP_ATTEMPTS_HASH_SIZE = 256;
+
+
+struct LoopConditional
+{
+  Function *function;
+
+  // The car's value at the conditional, relative to the start of the lap
+  s64 value_offset;
+
+  b32 outcome;
+};
+
+
+struct CarLoop
+{
+  u32 length;
+  s64 value_change;
+
+  s64 min_value_offset;
+  s64 max_value_offset;
+
+  u32 n_conditionals;
+  LoopConditional conditionals[MAX_LOOP_CONDITIONALS];
+};
+
+
+struct LoopAttempts
+{
+  u32 cell_x;
+  u32 cell_y;
+  u8 direction;
+  u8 used;
+
+  u16 failures;
+  u32 hits_to_skip;
+};
+
+
+struct Loops
+{
+  b32 enabled;
+
+  // Open addressed hash table of loop attempts, keyed by cell and
+  //   direction
+  LoopAttempts *attempts;
+  u32 hash_size;
+  u32 n_attempts;
+
+  CarLoop scratch_loop;
+};
+
+
+void
+accelerate_car_loop(Memory *memory, Loops *loops, Maze *maze, Functions *functions, Car car, CarDirection arrival_direction);
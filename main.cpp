@@ -4,33 +4,25 @@
 
 #include "engine/engine-includes.h"
 
-#include "logging-channels.h"
-#include "functions.h"
+#include "mazesim.h"
+
 #include "world-position.h"
 #include "particles.h"
-#include "cells-storage.h"
-#include "cars-storage.h"
-#include "cars.h"
-#include "parser.h"
+#include "cells-render.h"
+#include "cars-render.h"
 #include "ui.h"
-#include "cells.h"
-#include "serialize.h"
 #include "input.h"
 #include "opengl-cells-instancing.h"
 
 #include "maze-interpreter.h"
 
-#include "logging-channels.cpp"
-#include "functions.cpp"
+#include "mazesim.cpp"
+
 #include "world-position.cpp"
 #include "particles.cpp"
-#include "cells-storage.cpp"
-#include "cars-storage.cpp"
-#include "parser.cpp"
 #include "ui.cpp"
-#include "cars.cpp"
-#include "cells.cpp"
-#include "serialize.cpp"
+#include "cells-render.cpp"
+#include "cars-render.cpp"
 #include "input.cpp"
 #include "opengl-cells-instancing.cpp"
 
@@ -106,7 +106,7 @@ reset_zoom(GameState *game_state)
   panning->world_maze_pos.offset = (vec2){0, 0};
 
   // TODO: Centre maze at start
-  vec2 maze_size = get_maze_size(&game_state->maze);
+  vec2 maze_size = get_maze_size(&game_state->sim->maze);
   vec2 maze_center = 0.5f * maze_size;
   panning->world_maze_pos.cell_x = maze_center.x;
   panning->world_maze_pos.cell_y = maze_center.y;
@@ -116,15 +116,16 @@ reset_zoom(GameState *game_state)
 b32
 load_maze(Memory *memory, GameState *game_state)
 {
-  b32 success = true;
-  success &= parse(&game_state->maze, &game_state->functions, memory, game_state->filename);
+  b32 success = load_sim_maze(memory, game_state->sim, game_state->filename);
 
-  delete_all_cars(&game_state->cars);
   reset_car_inputs(&game_state->ui);
+  zero(&game_state->maze_edits, MazeEdits);
+  clear_cells_ui_state(&game_state->cells_ui_state);
+  clear_cell_instance_positions(&game_state->cell_instancing);
 
   game_state->finish_sim_step_move = false;
   game_state->last_sim_tick = 0;
-  game_state->sim_steps = 0;
+  game_state->last_n_outputs = 0;
 
   return success;
 }
@@ -202,6 +203,22 @@ init_game(Memory *memory, GameState *game_state, Keys *keys, u64 time_us, u32 ar
     success = false;
   }
   else
+  {
+    // NOTE: The GUI steps the sim one tick at a time so the cars can be
+    //         animated, so corridor compression, loop acceleration and
+    //         merging are left off.
+    SimOptions options = {};
+    options.n_threads = 1;
+    options.track_dirty_chunks = true;
+    game_state->sim = init_sim(memory, &options);
+
+    if (!game_state->sim)
+    {
+      success = false;
+    }
+  }
+
+  if (success)
   {
     b32 assets_loaded = load_assets(memory, game_state);
     b32 maze_loaded = load_maze(memory, game_state);
@@ -214,7 +231,7 @@ init_game(Memory *memory, GameState *game_state, Keys *keys, u64 time_us, u32 ar
       setup_inputs(keys, &game_state->inputs);
       reset_zoom(game_state);
 
-      add_all_cell_instances(&game_state->cell_instancing, &game_state->maze.tree);
+      add_all_cell_instances(&game_state->cell_instancing, memory, &game_state->sim->maze);
 
       add_glyph_to_general_vertices(&game_state->font, &game_state->general_vertices, memory, 1, U'{',
                                     &game_state->test_character_vbo, &game_state->test_character_ibo);
@@ -253,7 +270,7 @@ update_and_render(Memory *memory, Memory *frame_memory, Renderer *renderer,
 
   if (game_state->inputs.maps[SAVE].active)
   {
-    serialize_maze(&game_state->maze, &game_state->functions, game_state->filename);
+    save_maze(&game_state->sim->maze, &game_state->sim->functions, game_state->filename, frame_memory, &game_state->maze_edits);
   }
 
   if (game_state->inputs.maps[RELOAD].active)
@@ -271,11 +288,11 @@ update_and_render(Memory *memory, Memory *frame_memory, Renderer *renderer,
   if (game_state->inputs.maps[RESTART].active)
   {
     load_debug_persistent_str(u8("Restart!"), game_state);
-    delete_all_cars(&game_state->cars);
+    restart_sim(game_state->sim);
     reset_car_inputs(&game_state->ui);
     game_state->finish_sim_step_move = false;
     game_state->last_sim_tick = 0;
-    game_state->sim_steps = 0;
+    game_state->last_n_outputs = 0;
   }
 
   if (game_state->inputs.maps[STEP_MODE_TOGGLE].active)
@@ -307,25 +324,46 @@ update_and_render(Memory *memory, Memory *frame_memory, Renderer *renderer,
   }
   game_state->sim_ticks_per_s = clamp(.5, game_state->sim_ticks_per_s, 20);
 
-  // update_cells_ui_state(game_state, mouse, world_mouse, time_us);
+  // update_cells_ui_state(memory, game_state, mouse, world_mouse, time_us);
 
   b32 sim = sim_tick(game_state, time_us);
 
   if (sim && game_state->ui.car_inputs == 0 && !game_state->finish_sim_step_move)
   {
-    perform_cells_sim_tick(memory, game_state, &(game_state->maze.tree), time_us);
-    perform_cars_sim_tick(memory, game_state, time_us);
+    perform_cells_sim_tick(memory, game_state->sim);
+    perform_cars_sim_tick(memory, game_state->sim);
+
+    for (u32 input_index = 0;
+         input_index < game_state->sim->n_input_car_ids;
+         ++input_index)
+    {
+      u32 car_id = game_state->sim->input_car_ids[input_index];
+
+      Car car;
+      if (get_car_with_id(&game_state->sim->cars, car_id, &car))
+      {
+        init_car_input_box(memory, game_state, car_id, *car_value(car), get_car_world_pos(&game_state->car_presentations, car));
+      }
+    }
+
+    if (game_state->sim->n_outputs != game_state->last_n_outputs)
+    {
+      game_state->last_n_outputs = game_state->sim->n_outputs;
+      formatted_string(game_state->persistent_str, array_count(game_state->persistent_str), u8("%d"), game_state->sim->last_output);
+    }
   }
 
   if (sim && game_state->ui.car_inputs == 0)
   {
-    move_cars(game_state);
+    move_cars(game_state->sim);
 
     game_state->finish_sim_step_move = false;
-    ++game_state->sim_steps;
+    ++game_state->sim->sim_steps;
   }
 
-  annimate_cars(game_state, last_frame_dt);
+  update_dirty_cell_instances(&game_state->cell_instancing, memory, &game_state->sim->maze);
+
+  annimate_cars(memory, game_state, time_us, last_frame_dt);
   step_particles(&(game_state->particles), time_us);
 
   // update_ui(game_state, &game_state->ui, ui_mouse, &game_state->inputs, time_us);
@@ -347,8 +385,8 @@ update_and_render(Memory *memory, Memory *frame_memory, Renderer *renderer,
 
   debug_render_font_outline(game_state->general_screen_vao, &game_state->screen_space_rendering, &game_state->general_vertices, game_state->test_character_vbo, game_state->test_character_ibo);
 
-  // draw_cells(game_state, &render_window, &(game_state->maze.tree), time_us);
-  // draw_cars(game_state, &render_window, &(game_state->cars), time_us);
+  // draw_cells(game_state, &render_window, &(game_state->sim->maze), time_us);
+  // draw_cars(game_state, &render_window, &(game_state->sim->cars), time_us);
   // render_particles(&(game_state->particles), renderer, &render_basis);
 
 
@@ -28,6 +28,7 @@ struct GameState
   Panning panning;
 
   CellInstancing cell_instancing;
+  CellsUIState cells_ui_state;
   ScreenSpaceRendering screen_space_rendering;
   GeneralVertices general_vertices;
   GLuint general_screen_vao;
@@ -39,13 +40,13 @@ struct GameState
   u64 last_sim_tick;
   r32 sim_ticks_per_s;
 
-  u32 sim_steps;
   b32 finish_sim_step_move;
+  u64 last_n_outputs;
 
   Inputs inputs;
-  Maze maze;
-  Functions functions;
-  Cars cars;
+  SimState *sim;
+  MazeEdits maze_edits;
+  CarPresentations car_presentations;
   Particles particles;
 
   CellBitmaps cell_bitmaps;
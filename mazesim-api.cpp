@@ -0,0 +1,265 @@
+struct MazeSim
+{
+  Memory memory;
+  b32 owns_memory;
+
+  SimState *sim;
+};
+
+
+void
+mazesim_default_config(MazeSimConfig *config)
+{
+  config->n_threads = 1;
+  config->compress_corridors = true;
+  config->accelerate_loops = true;
+  config->merge_identical_cars = false;
+  config->compress_rows = false;
+  config->track_active_regions = false;
+  config->prune_unreachable = false;
+  config->memory = 0;
+  config->memory_size = DEFAULT_SIM_MEMORY;
+  config->output_callback = 0;
+  config->user_data = 0;
+}
+
+
+MazeSim *
+mazesim_create(const MazeSimConfig *config)
+{
+  MazeSim *result = 0;
+
+  Memory memory;
+  memory.total = config->memory_size;
+  memory.used = 0;
+  memory.memory = (u8 *)config->memory;
+
+  b32 owns_memory = false;
+  if (!memory.memory)
+  {
+    memory.memory = (u8 *)malloc(memory.total);
+    owns_memory = true;
+  }
+
+  if (memory.memory && memory.total > sizeof(MazeSim) + sizeof(SimState))
+  {
+    // NOTE: The context is the first thing in its own memory, so the
+    //         caller's memory holds everything.
+    result = push_struct(&memory, MazeSim);
+    result->memory = memory;
+    result->owns_memory = owns_memory;
+
+    SimOptions options = {};
+    options.n_threads = config->n_threads;
+    options.compress_corridors = config->compress_corridors;
+    options.accelerate_loops = config->accelerate_loops;
+    options.merge_identical_cars = config->merge_identical_cars;
+    options.compress_rows = config->compress_rows;
+    options.track_active_chunks = config->track_active_regions;
+    options.prune_unreachable = config->prune_unreachable;
+    options.output_callback = config->output_callback;
+    options.output_user_data = config->user_data;
+
+    result->sim = init_sim(&result->memory, &options);
+    if (!result->sim)
+    {
+      result = 0;
+    }
+  }
+
+  if (!result && owns_memory)
+  {
+    free(memory.memory);
+  }
+
+  return result;
+}
+
+
+void
+mazesim_destroy(MazeSim *sim)
+{
+  stop_sim(sim->sim);
+
+  if (sim->owns_memory)
+  {
+    free(sim->memory.memory);
+  }
+}
+
+
+int
+mazesim_load(MazeSim *sim, const char *data, size_t size)
+{
+  b32 success = load_sim_maze(&sim->memory, sim->sim, (const u8 *)data, size);
+  return success;
+}
+
+
+int
+mazesim_load_file(MazeSim *sim, const char *filename)
+{
+  b32 success = load_sim_maze(&sim->memory, sim->sim, (const u8 *)filename);
+  return success;
+}
+
+
+int
+mazesim_compile(MazeSim *sim, const char *filename)
+{
+  b32 success = compile_sim_maze(sim->sim, (const u8 *)filename);
+  return success;
+}
+
+
+void
+mazesim_restart(MazeSim *sim)
+{
+  restart_sim(sim->sim);
+}
+
+
+MazeSimStatus
+mazesim_run(MazeSim *sim, uint64_t max_ticks)
+{
+  MazeSimStatus result = sim_finished(sim->sim) ? MAZESIM_FINISHED : MAZESIM_RUNNING;
+
+  u64 ticks_left = max_ticks;
+  while (result == MAZESIM_RUNNING &&
+         ticks_left > 0)
+  {
+    u32 start_ticks = get_sim_steps(sim->sim);
+    step_sim(&sim->memory, sim->sim, min(ticks_left, (u64)MAX_U32));
+    ticks_left -= get_sim_steps(sim->sim) - start_ticks;
+
+    if (sim_finished(sim->sim))
+    {
+      result = MAZESIM_FINISHED;
+    }
+    else if (sim->sim->n_input_car_ids)
+    {
+      result = MAZESIM_NEEDS_INPUT;
+    }
+  }
+
+  return result;
+}
+
+
+MazeSimStatus
+mazesim_run_to_completion(MazeSim *sim)
+{
+  MazeSimStatus result = mazesim_run(sim, UINT64_MAX);
+  return result;
+}
+
+
+uint64_t
+mazesim_get_ticks(MazeSim *sim)
+{
+  return get_sim_steps(sim->sim);
+}
+
+
+uint64_t
+mazesim_get_n_pruned_cells(MazeSim *sim)
+{
+  return get_n_pruned_cells(sim->sim);
+}
+
+
+uint32_t
+mazesim_get_input_requests(MazeSim *sim, uint32_t *car_ids, uint32_t max_car_ids)
+{
+  u32 n_car_ids = min(sim->sim->n_input_car_ids, max_car_ids);
+  memcpy(car_ids, sim->sim->input_car_ids, n_car_ids * sizeof(u32));
+
+  return sim->sim->n_input_car_ids;
+}
+
+
+int
+mazesim_set_car_value(MazeSim *sim, uint32_t car_id, int32_t value)
+{
+  Car car;
+  b32 found = get_car_with_id(&sim->sim->cars, car_id, &car);
+  if (found)
+  {
+    *car_value(car) = value;
+  }
+
+  return found;
+}
+
+
+uint32_t
+mazesim_get_n_cars(MazeSim *sim)
+{
+  return get_n_cars(&sim->sim->cars);
+}
+
+
+void
+get_mazesim_car(Car car, MazeSimCar *result)
+{
+  result->id = *car_id(car);
+  result->x = *car_cell_x(car);
+  result->y = *car_cell_y(car);
+  result->value = *car_value(car);
+  result->direction = (MazeSimDirection)get_car_direction(car);
+  result->pause_left = get_car_pause_left(car);
+  result->count = *car_count(car);
+}
+
+
+uint32_t
+mazesim_get_cars(MazeSim *sim, MazeSimCar *cars, uint32_t max_cars)
+{
+  u32 n_cars = 0;
+
+  CarsIterator iter = {};
+  Car car;
+  while (n_cars < max_cars &&
+         cars_iterator(&sim->sim->cars, &iter, &car))
+  {
+    get_mazesim_car(car, cars + n_cars);
+    ++n_cars;
+  }
+
+  return n_cars;
+}
+
+
+int
+mazesim_get_car(MazeSim *sim, uint32_t car_id, MazeSimCar *result)
+{
+  Car car;
+  b32 found = get_car_with_id(&sim->sim->cars, car_id, &car);
+  if (found)
+  {
+    get_mazesim_car(car, result);
+  }
+
+  return found;
+}
+
+
+uint32_t
+mazesim_get_active_regions(MazeSim *sim, MazeSimRegion *regions, uint32_t max_regions)
+{
+  Maze *maze = &sim->sim->maze;
+
+  u32 n_regions = 0;
+  CellChunk *chunk = maze->first_active_chunk;
+  while (chunk && n_regions < max_regions)
+  {
+    MazeSimRegion *region = regions + n_regions++;
+    region->x = chunk->chunk_x << CELL_CHUNK_SIZE_BITS;
+    region->y = chunk->chunk_y << CELL_CHUNK_SIZE_BITS;
+    region->size = CELL_CHUNK_SIZE;
+
+    chunk = chunk->next_active_chunk;
+  }
+
+  return maze->n_active_chunks;
+}
\ No newline at end of file
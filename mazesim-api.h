@@ -0,0 +1,184 @@
+// The C interface to libmazesim, for running mazes inside another
+//   process.
+//
+// All of a sim's state is in its MazeSim context, there are no globals,
+//   so any number of contexts can be used at once, each from one thread
+//   at a time.
+//
+// A context runs in one block of memory, either the caller's or
+//   malloc'd by mazesim_create(). Running out of it is fatal, so it
+//   should be sized for the largest maze and number of cars expected.
+//
+// Mazes can be loaded from either the text format, or the compiled
+//   format written by mazesim_compile(). Compiled maze files are
+//   mapped and used in place, so load in a few milliseconds.
+// Text maze files too big to map, over 2GB, are read a window at a
+//   time, so only the maze's cells are held in memory.
+//
+// Running:
+// - mazesim_run() runs up to max_ticks ticks, and returns early when the
+//     sim finishes, or when cars reach input cells.
+// - When it returns MAZESIM_NEEDS_INPUT the waiting cars are listed by
+//     mazesim_get_input_requests(), their values can be set with
+//     mazesim_set_car_value() before calling mazesim_run() again.
+// - Outputs are passed to the output callback as they happen.
+
+#ifndef MAZESIM_API_H
+#define MAZESIM_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+typedef struct MazeSim MazeSim;
+
+
+// count is the number of identical cars the value is output for, it is
+//   only more than one when merge_identical_cars is set.
+typedef void (*MazeSimOutputCallback)(void *user_data, int32_t value, uint64_t count);
+
+
+typedef struct MazeSimConfig
+{
+  uint32_t n_threads;
+
+  int compress_corridors;
+  int accelerate_loops;
+  int merge_identical_cars;
+
+  // Stores the maze as runs of identical cells along each row, so mostly
+  //   uniform mazes take a fraction of the memory. Corridors aren't
+  //   compressed, and the maze can't be compiled, in this mode.
+  int compress_rows;
+
+  // Lists the regions of the maze holding cars at the start of each tick,
+  //   for mazesim_get_active_regions(). Costs a little for every car.
+  int track_active_regions;
+
+  // Removes the cells no car can reach from the start cells as the maze
+  //   is loaded, so they aren't analysed or compiled. Not done when
+  //   compress_rows is set.
+  int prune_unreachable;
+
+  // The memory for the context, if memory is 0, memory_size bytes are
+  //   malloc'd and freed by mazesim_destroy().
+  void *memory;
+  size_t memory_size;
+
+  // Outputs are printed to stdout if this is 0
+  MazeSimOutputCallback output_callback;
+  void *user_data;
+} MazeSimConfig;
+
+
+typedef enum MazeSimStatus
+{
+  MAZESIM_RUNNING,
+  MAZESIM_FINISHED,
+  MAZESIM_NEEDS_INPUT
+} MazeSimStatus;
+
+
+typedef enum MazeSimDirection
+{
+  MAZESIM_UP,
+  MAZESIM_DOWN,
+  MAZESIM_RIGHT,
+  MAZESIM_LEFT,
+  MAZESIM_STATIONARY
+} MazeSimDirection;
+
+
+// A square of cells in the maze
+typedef struct MazeSimRegion
+{
+  uint32_t x;
+  uint32_t y;
+  uint32_t size;
+} MazeSimRegion;
+
+
+typedef struct MazeSimCar
+{
+  uint32_t id;
+  uint32_t x;
+  uint32_t y;
+  int32_t value;
+  MazeSimDirection direction;
+  uint32_t pause_left;
+  uint64_t count;
+} MazeSimCar;
+
+
+void
+mazesim_default_config(MazeSimConfig *config);
+
+MazeSim *
+mazesim_create(const MazeSimConfig *config);
+
+void
+mazesim_destroy(MazeSim *sim);
+
+
+int
+mazesim_load(MazeSim *sim, const char *data, size_t size);
+
+int
+mazesim_load_file(MazeSim *sim, const char *filename);
+
+// Writes the loaded maze in the compiled format, before it is run
+int
+mazesim_compile(MazeSim *sim, const char *filename);
+
+void
+mazesim_restart(MazeSim *sim);
+
+
+MazeSimStatus
+mazesim_run(MazeSim *sim, uint64_t max_ticks);
+
+MazeSimStatus
+mazesim_run_to_completion(MazeSim *sim);
+
+uint64_t
+mazesim_get_ticks(MazeSim *sim);
+
+// The number of cells removed from the last maze loaded, when
+//   prune_unreachable is set
+uint64_t
+mazesim_get_n_pruned_cells(MazeSim *sim);
+
+
+uint32_t
+mazesim_get_input_requests(MazeSim *sim, uint32_t *car_ids, uint32_t max_car_ids);
+
+int
+mazesim_set_car_value(MazeSim *sim, uint32_t car_id, int32_t value);
+
+
+uint32_t
+mazesim_get_n_cars(MazeSim *sim);
+
+uint32_t
+mazesim_get_cars(MazeSim *sim, MazeSimCar *cars, uint32_t max_cars);
+
+int
+mazesim_get_car(MazeSim *sim, uint32_t car_id, MazeSimCar *car);
+
+
+// The regions holding cars at the start of the last tick run, only listed
+//   when track_active_regions is set. Returns the number of regions,
+//   which can be more than max_regions.
+uint32_t
+mazesim_get_active_regions(MazeSim *sim, MazeSimRegion *regions, uint32_t max_regions);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
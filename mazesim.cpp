@@ -0,0 +1,14 @@
+#include "logging-channels.cpp"
+#include "sim-threads.cpp"
+#include "functions.cpp"
+#include "cells-storage.cpp"
+#include "cars-storage.cpp"
+#include "parser.cpp"
+#include "compiled-maze.cpp"
+#include "cars.cpp"
+#include "cells.cpp"
+#include "reachability.cpp"
+#include "corridors.cpp"
+#include "loops.cpp"
+#include "serialize.cpp"
+#include "sim.cpp"
\ No newline at end of file
@@ -0,0 +1,15 @@
+#include "logging-channels.h"
+#include "sim-threads.h"
+#include "functions.h"
+#include "cells-storage.h"
+#include "cars-storage.h"
+#include "corridors.h"
+#include "loops.h"
+#include "cars.h"
+#include "parser.h"
+#include "compiled-maze.h"
+#include "cells.h"
+#include "reachability.h"
+#include "serialize.h"
+#include "sim.h"
+#include "sim-state.h"
\ No newline at end of file
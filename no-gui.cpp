@@ -1,91 +1,118 @@
-#define DEBUG
-// #define DEBUG_BLOCK_COLORS
+// Runs a maze without the GUI, linked against libmazesim.
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "engine/engine-includes.h"
-
-#include "logging-channels.h"
-#include "functions.h"
-#include "world-position.h"
-#include "particles.h"
-#include "cells-storage.h"
-#include "cars-storage.h"
-#include "cars.h"
-#include "parser.h"
-#include "ui.h"
-#include "cells.h"
-#include "serialize.h"
-#include "input.h"
-#include "opengl-cells-instancing.h"
-
-#include "maze-interpreter.h"
-
-#include "logging-channels.cpp"
-#include "functions.cpp"
-#include "world-position.cpp"
-#include "particles.cpp"
-#include "cells-storage.cpp"
-#include "cars-storage.cpp"
-#include "parser.cpp"
-#include "ui.cpp"
-#include "cars.cpp"
-#include "cells.cpp"
-#include "serialize.cpp"
-#include "input.cpp"
-#include "opengl-cells-instancing.cpp"
-
-#include "maze-interpreter.cpp"
+#include "mazesim-api.h"
 
 
 int
 main(int argc, char const *argv[])
 {
-  register_game_logging_channels(GAME_LOGGING_CHANNEL_DEFINITIONS);
-
-  Memory memory;
-  memory.total = TOTAL_MEMORY;
-  memory.memory = (u8 *)malloc(memory.total);
-  memory.used = 0;
+  MazeSimConfig config;
+  mazesim_default_config(&config);
 
-  GameState gs;
-  GameState *game_state = &gs;
+  const char *filename = 0;
+  const char *compile_filename = 0;
 
-  game_state->init = true;
-  game_state->ui.car_inputs = 0;
-
-  game_state->single_step = false;
-  game_state->sim_ticks_per_s = 5;
+  for (int arg_index = 1;
+       arg_index < argc;
+       ++arg_index)
+  {
+    const char *arg = argv[arg_index];
+
+    if (strcmp(arg, "--threads") == 0)
+    {
+      if (arg_index + 1 < argc)
+      {
+        ++arg_index;
+        config.n_threads = strtoul(argv[arg_index], 0, 10);
+      }
+      else
+      {
+        printf("Error: --threads needs a number of threads.\n");
+        return 0;
+      }
+    }
+    else if (strcmp(arg, "--no-corridors") == 0)
+    {
+      config.compress_corridors = false;
+    }
+    else if (strcmp(arg, "--no-loops") == 0)
+    {
+      config.accelerate_loops = false;
+    }
+    else if (strcmp(arg, "--merge-cars") == 0)
+    {
+      config.merge_identical_cars = true;
+    }
+    else if (strcmp(arg, "--compress-rows") == 0)
+    {
+      config.compress_rows = true;
+    }
+    else if (strcmp(arg, "--prune-unreachable") == 0)
+    {
+      config.prune_unreachable = true;
+    }
+    else if (strcmp(arg, "--compile") == 0)
+    {
+      if (arg_index + 1 < argc)
+      {
+        ++arg_index;
+        compile_filename = argv[arg_index];
+      }
+      else
+      {
+        printf("Error: --compile needs an output filename.\n");
+        return 0;
+      }
+    }
+    else
+    {
+      filename = arg;
+    }
+  }
 
-  if (argc > 1)
+  if (!filename)
   {
-    game_state->filename = argv[1];
+    printf("Usage: %s [--threads N] [--no-corridors] [--no-loops] [--merge-cars] [--compress-rows] [--prune-unreachable] [--compile out-file] maze-file\n", argv[0]);
+    return 0;
   }
-  else
+
+  MazeSim *sim = mazesim_create(&config);
+  if (!sim)
   {
-    printf("Error: No Maze filename supplied.\n");
+    printf("Error: Couldn't start sim threads.\n");
     return 0;
   }
 
-  b32 success = load_maze(&memory, game_state, argc, argv);
-  if (!success)
+  if (!mazesim_load_file(sim, filename))
   {
     printf("Error: Couldn't load maze.\n");
     return 0;
   }
 
-  game_state->cars.first_block = 0;
-  game_state->cars.free_chain = 0;
-
-  do
+  if (config.prune_unreachable)
   {
-    perform_cells_sim_tick(&memory, game_state, &(game_state->maze.tree), 0);
-    perform_cars_sim_tick(&memory, game_state, 0);
-
-    move_cars(game_state);
+    fprintf(stderr, "Pruned %llu unreachable cells.\n", (unsigned long long)mazesim_get_n_pruned_cells(sim));
+  }
 
-    ++game_state->sim_steps;
+  if (compile_filename)
+  {
+    if (!mazesim_compile(sim, compile_filename))
+    {
+      printf("Error: Couldn't compile maze.\n");
+    }
   }
-  while (game_state->cars.first_block != 0);
+  else
+  {
+    // NOTE: There's no way to give inputs here, so cars just keep their
+    //         values.
+    while (mazesim_run_to_completion(sim) == MAZESIM_NEEDS_INPUT);
+  }
+
+  mazesim_destroy(sim);
 
   return 0;
 }
\ No newline at end of file
@@ -1,12 +1,118 @@
 // Cells storage in instance VBO:
 //  - Allocate block of X bytes
 //  - Use block for contiguous array of CellInstances
-//  - Record CellInstance positions in QuadTree Cells
+//  - Record CellInstance positions in each chunk's ChunkInstancePositions
 
 
 // TODO: Separate instance types for the different cell types.
 
 
+void
+insert_chunk_instance_positions_into_hash(ChunkInstancePositions **hash, u32 hash_size, ChunkInstancePositions *chunk_positions)
+{
+  u32 slot = get_chunk_hash_slot(chunk_positions->chunk_x, chunk_positions->chunk_y, hash_size);
+  while (hash[slot])
+  {
+    slot = (slot + 1) & (hash_size - 1);
+  }
+  hash[slot] = chunk_positions;
+}
+
+
+// Returns 0 if the chunk has no positions and memory is 0
+ChunkInstancePositions *
+find_or_create_chunk_instance_positions(CellInstancing *cell_instancing, u32 chunk_x, u32 chunk_y, Memory *memory = 0)
+{
+  ChunkInstancePositions *chunk_positions = 0;
+  if (cell_instancing->chunk_positions_hash)
+  {
+    u32 slot = get_chunk_hash_slot(chunk_x, chunk_y, cell_instancing->chunk_positions_hash_size);
+    while (cell_instancing->chunk_positions_hash[slot])
+    {
+      ChunkInstancePositions *test_positions = cell_instancing->chunk_positions_hash[slot];
+      if (test_positions->chunk_x == chunk_x &&
+          test_positions->chunk_y == chunk_y)
+      {
+        chunk_positions = test_positions;
+        break;
+      }
+      slot = (slot + 1) & (cell_instancing->chunk_positions_hash_size - 1);
+    }
+  }
+
+  if (!chunk_positions && memory)
+  {
+    if (2 * (cell_instancing->n_chunk_positions + 1) > cell_instancing->chunk_positions_hash_size)
+    {
+      u32 old_hash_size = cell_instancing->chunk_positions_hash_size;
+      u32 new_hash_size = old_hash_size ? 2 * old_hash_size : INITIAL_CHUNK_INSTANCE_POSITIONS_HASH_SIZE;
+
+      // NOTE: The old table is left in the arena, like the chunk hash.
+      ChunkInstancePositions **new_hash = push_structs(memory, ChunkInstancePositions *, new_hash_size);
+      zero_n(new_hash, ChunkInstancePositions *, new_hash_size);
+
+      for (u32 slot = 0;
+           slot < old_hash_size;
+           ++slot)
+      {
+        if (cell_instancing->chunk_positions_hash[slot])
+        {
+          insert_chunk_instance_positions_into_hash(new_hash, new_hash_size, cell_instancing->chunk_positions_hash[slot]);
+        }
+      }
+
+      cell_instancing->chunk_positions_hash = new_hash;
+      cell_instancing->chunk_positions_hash_size = new_hash_size;
+    }
+
+    chunk_positions = push_struct(memory, ChunkInstancePositions);
+    chunk_positions->chunk_x = chunk_x;
+    chunk_positions->chunk_y = chunk_y;
+    chunk_positions->unreachable = false;
+    chunk_positions->background_position = INVALID_GL_BUFFER_ELEMENT_POSITION;
+    for (u32 cell_index = 0;
+         cell_index < CELLS_PER_CHUNK;
+         ++cell_index)
+    {
+      chunk_positions->positions[cell_index] = INVALID_GL_BUFFER_ELEMENT_POSITION;
+    }
+
+    insert_chunk_instance_positions_into_hash(cell_instancing->chunk_positions_hash, cell_instancing->chunk_positions_hash_size, chunk_positions);
+    ++cell_instancing->n_chunk_positions;
+  }
+
+  return chunk_positions;
+}
+
+
+// Returns 0 if the cell's chunk has no positions and memory is 0
+u32 *
+find_or_create_cell_instance_position(CellInstancing *cell_instancing, u32 cell_x, u32 cell_y, Memory *memory = 0)
+{
+  u32 *result = 0;
+
+  ChunkInstancePositions *chunk_positions = find_or_create_chunk_instance_positions(cell_instancing, cell_x >> CELL_CHUNK_SIZE_BITS, cell_y >> CELL_CHUNK_SIZE_BITS, memory);
+  if (chunk_positions)
+  {
+    result = chunk_positions->positions + get_cell_index_in_chunk(cell_x, cell_y);
+  }
+
+  return result;
+}
+
+
+// NOTE: The chunks' positions are left in the arena.
+void
+clear_cell_instance_positions(CellInstancing *cell_instancing)
+{
+  if (cell_instancing->chunk_positions_hash)
+  {
+    zero_n(cell_instancing->chunk_positions_hash, ChunkInstancePositions *, cell_instancing->chunk_positions_hash_size);
+  }
+  cell_instancing->n_chunk_positions = 0;
+}
+
+
 void
 update_cell_instance(CellInstancing *cell_instancing, u32 cell_instance_position, CellInstance *cell_instance)
 {
@@ -15,18 +121,19 @@ update_cell_instance(CellInstancing *cell_instancing, u32 cell_instance_position
 
 
 void
-add_cell_instance(CellInstancing *cell_instancing, Cell *cell)
+add_cell_instance(CellInstancing *cell_instancing, Memory *memory, Cell *cell, u32 cell_x, u32 cell_y)
 {
   CellInstance cell_instance = {
-    .world_cell_position_x = (s32)cell->x,
-    .world_cell_position_y = (s32)cell->y,
+    .world_cell_position_x = (s32)cell_x,
+    .world_cell_position_y = (s32)cell_y,
     .world_cell_offset = {0, 0},
 
     // TODO: This is temporary until we have the different cell types in different instance arrays.
     .colour = get_cell_color(cell->type)
   };
 
-  cell->opengl_instance_position = new_buffer_element(L_CellInstancing, &cell_instancing->cell_instances_vbo, &cell_instance);
+  u32 *instance_position = find_or_create_cell_instance_position(cell_instancing, cell_x, cell_y, memory);
+  *instance_position = new_buffer_element(L_CellInstancing, &cell_instancing->cell_instances_vbo, &cell_instance);
 
   log(L_CellInstancing, u8("n_cell_instances: %u, out of cell_instances_vbo_size: %u"),
       cell_instancing->cell_instances_vbo.elements_used, cell_instancing->cell_instances_vbo.total_elements);
@@ -34,46 +141,195 @@ add_cell_instance(CellInstancing *cell_instancing, Cell *cell)
 
 
 void
-recurse_adding_all_cell_instances(CellInstancing *cell_instancing, QuadTree *tree)
+add_chunk_background(CellInstancing *cell_instancing, Memory *memory, CellChunk *chunk)
 {
-  if (tree)
+  CellInstance background_instance = {
+    .world_cell_position_x = (s32)(chunk->chunk_x << CELL_CHUNK_SIZE_BITS),
+    .world_cell_position_y = (s32)(chunk->chunk_y << CELL_CHUNK_SIZE_BITS),
+    .world_cell_offset = {0, 0},
+    .colour = UNREACHABLE_CHUNK_COLOR
+  };
+
+  ChunkInstancePositions *chunk_positions = find_or_create_chunk_instance_positions(cell_instancing, chunk->chunk_x, chunk->chunk_y, memory);
+  chunk_positions->unreachable = true;
+  chunk_positions->background_position = new_buffer_element(L_CellInstancing, &cell_instancing->chunk_instances_vbo, &background_instance);
+}
+
+
+void
+remove_chunk_background(CellInstancing *cell_instancing, ChunkInstancePositions *chunk_positions)
+{
+  OpenGL_Buffer *chunk_instances_vbo = &cell_instancing->chunk_instances_vbo;
+
+  u32 background_position = chunk_positions->background_position;
+  chunk_positions->unreachable = false;
+  chunk_positions->background_position = INVALID_GL_BUFFER_ELEMENT_POSITION;
+
+  remove_buffer_element(chunk_instances_vbo, background_position);
+
+  // The last background has been moved into the removed one's position,
+  //   and its chunk needs to know its new position.
+  if (background_position < chunk_instances_vbo->elements_used)
   {
-    for (u32 cell_index = 0;
-         cell_index < tree->used;
-         ++cell_index)
+    glBindBuffer(chunk_instances_vbo->binding_target, chunk_instances_vbo->id);
+
+    CellInstance moved_background_instance;
+    glGetBufferSubData(chunk_instances_vbo->binding_target, background_position * chunk_instances_vbo->element_size, chunk_instances_vbo->element_size, &moved_background_instance);
+
+    glBindBuffer(chunk_instances_vbo->binding_target, 0);
+
+    ChunkInstancePositions *moved_chunk_positions = find_or_create_chunk_instance_positions(cell_instancing, (u32)moved_background_instance.world_cell_position_x >> CELL_CHUNK_SIZE_BITS, (u32)moved_background_instance.world_cell_position_y >> CELL_CHUNK_SIZE_BITS);
+    if (moved_chunk_positions)
+    {
+      moved_chunk_positions->background_position = background_position;
+    }
+  }
+}
+
+
+// The chunks no car can reach are drawn as a background rather than cell
+//   by cell, see find_unreachable_chunks(). Their cells are kept in the
+//   maze, so it can still be edited and saved.
+void
+add_all_cell_instances(CellInstancing *cell_instancing, Memory *memory, Maze *maze)
+{
+  u32 n_unreachable_chunks;
+  CellChunk **unreachable_chunks = find_unreachable_chunks(maze, memory, &n_unreachable_chunks);
+
+  glBindVertexArray(cell_instancing->chunk_vao);
+  for (u32 chunk_index = 0;
+       chunk_index < n_unreachable_chunks;
+       ++chunk_index)
+  {
+    add_chunk_background(cell_instancing, memory, unreachable_chunks[chunk_index]);
+  }
+  glBindVertexArray(0);
+
+  glBindVertexArray(cell_instancing->vao);
+
+  CellChunk *chunk = 0;
+  ChunkInstancePositions *chunk_positions = 0;
+
+  CellsIterator iter = {};
+  Cell *cell;
+  while ((cell = cells_iterator(maze, &iter)))
+  {
+    if (iter.chunk != chunk)
+    {
+      chunk = iter.chunk;
+      chunk_positions = find_or_create_chunk_instance_positions(cell_instancing, chunk->chunk_x, chunk->chunk_y, memory);
+    }
+
+    if (!chunk_positions->unreachable)
     {
-      Cell *cell = tree->cells + cell_index;
-      add_cell_instance(cell_instancing, cell);
+      add_cell_instance(cell_instancing, memory, cell, iter.x, iter.y);
     }
+  }
+  print_gl_errors();
+  log(L_CellInstancing, u8("Added all cell instances, %u chunks drawn as backgrounds."), n_unreachable_chunks);
+
+  glBindVertexArray(0);
+}
 
-    recurse_adding_all_cell_instances(cell_instancing, tree->top_right);
-    recurse_adding_all_cell_instances(cell_instancing, tree->top_left);
-    recurse_adding_all_cell_instances(cell_instancing, tree->bottom_right);
-    recurse_adding_all_cell_instances(cell_instancing, tree->bottom_left);
+
+// A cell in a chunk drawn as a background has changed, e.g. it has been
+//   edited, so the chunk's cells are drawn from then on.
+void
+add_unreachable_chunk_cells(CellInstancing *cell_instancing, Memory *memory, CellChunk *chunk, ChunkInstancePositions *chunk_positions)
+{
+  remove_chunk_background(cell_instancing, chunk_positions);
+
+  for (u32 cell_index = 0;
+       cell_index < CELLS_PER_CHUNK;
+       ++cell_index)
+  {
+    if (chunk_cell_exists(chunk, cell_index))
+    {
+      add_cell_instance(cell_instancing, memory, chunk->cells + cell_index, get_chunk_cell_x(chunk, cell_index), get_chunk_cell_y(chunk, cell_index));
+    }
   }
+
+  zero_n(chunk->cell_dirty, u32, CELLS_PER_CHUNK / 32);
 }
 
 
+// Uploads the cells which have changed type since they were last
+//   uploaded, only the maze's dirty chunks are looked at.
 void
-add_all_cell_instances(CellInstancing *cell_instancing, QuadTree *tree)
+update_dirty_cell_instances(CellInstancing *cell_instancing, Memory *memory, Maze *maze)
 {
   glBindVertexArray(cell_instancing->vao);
 
-  recurse_adding_all_cell_instances(cell_instancing, tree);
+  CellChunk *chunk;
+  while ((chunk = pop_dirty_chunk(maze)))
+  {
+    ChunkInstancePositions *chunk_positions = find_or_create_chunk_instance_positions(cell_instancing, chunk->chunk_x, chunk->chunk_y);
+    if (chunk_positions && chunk_positions->unreachable)
+    {
+      add_unreachable_chunk_cells(cell_instancing, memory, chunk, chunk_positions);
+      continue;
+    }
+
+    for (u32 cell_index = 0;
+         cell_index < CELLS_PER_CHUNK;
+         ++cell_index)
+    {
+      u32 *dirty_word = chunk->cell_dirty + (cell_index / 32);
+      if (*dirty_word == 0)
+      {
+        // Skip the rest of a clean word of the bitmap
+        cell_index = (cell_index / 32 + 1) * 32 - 1;
+        continue;
+      }
+
+      u32 dirty_bit = 1 << (cell_index % 32);
+      if (*dirty_word & dirty_bit)
+      {
+        *dirty_word &= ~dirty_bit;
+
+        if (chunk_cell_exists(chunk, cell_index))
+        {
+          Cell *cell = chunk->cells + cell_index;
+          u32 cell_x = get_chunk_cell_x(chunk, cell_index);
+          u32 cell_y = get_chunk_cell_y(chunk, cell_index);
+
+          u32 *instance_position = find_or_create_cell_instance_position(cell_instancing, cell_x, cell_y);
+          if (instance_position && *instance_position != INVALID_GL_BUFFER_ELEMENT_POSITION)
+          {
+            CellInstance cell_instance = {
+              .world_cell_position_x = (s32)cell_x,
+              .world_cell_position_y = (s32)cell_y,
+              .world_cell_offset = {0, 0},
+              .colour = get_cell_color(cell->type)
+            };
+            update_cell_instance(cell_instancing, *instance_position, &cell_instance);
+          }
+          else
+          {
+            add_cell_instance(cell_instancing, memory, cell, cell_x, cell_y);
+          }
+        }
+      }
+    }
+  }
   print_gl_errors();
-  log(L_CellInstancing, u8("Added all cell instances."));
 
   glBindVertexArray(0);
 }
 
 
 void
-remove_cell_instance(CellInstancing *cell_instancing, Maze *maze, Cell *cell)
+remove_cell_instance(CellInstancing *cell_instancing, u32 cell_x, u32 cell_y)
 {
   OpenGL_Buffer *cell_instances_vbo = &cell_instancing->cell_instances_vbo;
 
-  u32 cell_instance_position = cell->opengl_instance_position;
-  cell->opengl_instance_position = INVALID_GL_BUFFER_ELEMENT_POSITION;
+  u32 cell_instance_position = INVALID_GL_BUFFER_ELEMENT_POSITION;
+  u32 *instance_position = find_or_create_cell_instance_position(cell_instancing, cell_x, cell_y);
+  if (instance_position)
+  {
+    cell_instance_position = *instance_position;
+    *instance_position = INVALID_GL_BUFFER_ELEMENT_POSITION;
+  }
 
   log(L_CellInstancing, u8("Attempting to remove cell instance %u."), cell_instance_position);
 
@@ -94,14 +350,14 @@ remove_cell_instance(CellInstancing *cell_instancing, Maze *maze, Cell *cell)
 
     glBindBuffer(cell_instances_vbo->binding_target, 0);
 
-    Cell *moved_cell = get_cell(maze, moved_cell_instance.world_cell_position_x, moved_cell_instance.world_cell_position_y);
-    if (moved_cell)
+    u32 *moved_instance_position = find_or_create_cell_instance_position(cell_instancing, moved_cell_instance.world_cell_position_x, moved_cell_instance.world_cell_position_y);
+    if (moved_instance_position)
     {
-      moved_cell->opengl_instance_position = cell_instance_position;
+      *moved_instance_position = cell_instance_position;
     }
     else
     {
-      log(L_CellInstancing, u8("Could not get cell being moved from the Maze to update it's instance position"));
+      log(L_CellInstancing, u8("Could not get cell being moved from the ChunkInstancePositions to update it's instance position"));
     }
   }
 
@@ -122,6 +378,9 @@ draw_instanced_cells(CellInstancing *cell_instancing, Panning *panning, mat4 pro
   glUniform2f(uniforms->vec2_render_origin_offset.location, panning->world_maze_pos.offset.x, panning->world_maze_pos.offset.y);
   glUniform1f(uniforms->float_scale.location, panning->zoom);
 
+  glBindVertexArray(cell_instancing->chunk_vao);
+  glDrawElementsInstanced(GL_TRIANGLES, cell_instancing->chunk_vertex_ibo.elements_used, GL_UNSIGNED_SHORT, 0, cell_instancing->chunk_instances_vbo.elements_used);
+
   glBindVertexArray(cell_instancing->vao);
   glDrawElementsInstanced(GL_TRIANGLES, cell_instancing->cell_vertex_ibo.elements_used, GL_UNSIGNED_SHORT, 0, cell_instancing->cell_instances_vbo.elements_used);
   glBindVertexArray(0);
@@ -246,6 +505,14 @@ setup_cell_instancing(CellInstancing *cell_instancing)
   setup_cell_vertex_ibo(&cell_instancing->cell_vertex_ibo, CELL_TRIANGLE_INDICES, array_count(CELL_TRIANGLE_INDICES));
   setup_cell_instances_vbo(&cell_instancing->cell_instances_vbo);
 
+  // The unreachable chunks' backgrounds are drawn with the same shader
+  cell_instancing->chunk_vao = create_vao();
+  glBindVertexArray(cell_instancing->chunk_vao);
+
+  setup_cell_vertex_vbo(&cell_instancing->chunk_vertex_vbo, CHUNK_BACKGROUND_VERTICES,         array_count(CHUNK_BACKGROUND_VERTICES));
+  setup_cell_vertex_ibo(&cell_instancing->chunk_vertex_ibo, CHUNK_BACKGROUND_TRIANGLE_INDICES, array_count(CHUNK_BACKGROUND_TRIANGLE_INDICES));
+  setup_cell_instances_vbo(&cell_instancing->chunk_instances_vbo);
+
   glBindVertexArray(0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
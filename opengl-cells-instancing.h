@@ -14,6 +14,26 @@ struct CellUniforms
 };
 
 
+// The position of each cell's instance in cell_instances_vbo is kept in
+//   a dense array for each chunk of the maze, out of the sim's cells.
+//   The arrays are found through an open-addressing hash table keyed by
+//   the chunk's position, like the chunk hash.
+//
+// Chunks with no cells a car can reach are drawn as a single background
+//   quad instead of their cells, until one of their cells changes.
+struct ChunkInstancePositions
+{
+  u32 chunk_x;
+  u32 chunk_y;
+
+  b32 unreachable;
+  u32 background_position;  // In chunk_instances_vbo
+
+  u32 positions[CELLS_PER_CHUNK];
+};
+
+
+const u32 INITIAL_CHUNK_INSTANCE_POSITIONS_HASH_SIZE = 64;  // Must be a power of two
 struct CellInstancing
 {
   GLuint shader_program;
@@ -24,6 +44,16 @@ struct CellInstancing
   OpenGL_Buffer cell_vertex_vbo;
   OpenGL_Buffer cell_vertex_ibo;
   OpenGL_Buffer cell_instances_vbo;
+
+  GLuint chunk_vao;
+
+  OpenGL_Buffer chunk_vertex_vbo;
+  OpenGL_Buffer chunk_vertex_ibo;
+  OpenGL_Buffer chunk_instances_vbo;
+
+  ChunkInstancePositions **chunk_positions_hash;
+  u32 chunk_positions_hash_size;
+  u32 n_chunk_positions;
 };
 
 
@@ -62,4 +92,19 @@ const GLushort CELL_TRIANGLE_INDICES[] = {
   8,  10, 11,
   11, 2,  5, // Middle
   11, 5,  8
-};
\ No newline at end of file
+};
+
+
+const vec2 CHUNK_BACKGROUND_VERTICES[] = {
+  {0.0,             0.0},
+  {CELL_CHUNK_SIZE, 0.0},
+  {CELL_CHUNK_SIZE, CELL_CHUNK_SIZE},
+  {0.0,             CELL_CHUNK_SIZE}
+};
+
+const GLushort CHUNK_BACKGROUND_TRIANGLE_INDICES[] = {
+  0, 1, 2,
+  0, 2, 3
+};
+
+const vec4 UNREACHABLE_CHUNK_COLOR = {1, 0.95, 0.95, 0.95};
\ No newline at end of file
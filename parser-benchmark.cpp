@@ -0,0 +1,369 @@
+// Benchmark of the table driven maze lexer against the str_eq chain
+//   parser it replaced, and of parsing on several threads.
+//
+// Usage: parser-benchmark [--threads N] [maze-file ...]
+//   Defaults to a generated 16MB maze, and a thread for each CPU.
+
+
+// NOTE: Built on the library, so the parser is benchmarked without SDL or
+//         OpenGL like it is used by no-gui.
+#include "libmazesim.cpp"
+
+
+//
+// The parser as it was before the table driven lexer.
+//
+
+const u8 *
+old_parse_cell(Maze *maze, Functions *functions, const u8 cell_str[2], const u8 *f_ptr, const u8 *f_end, Cell *cell)
+{
+  if (str_eq(cell_str, u8("^^"), 2))
+  {
+    cell->type = CELL_START;
+  }
+  else if (str_eq(cell_str, u8(".."), 2))
+  {
+    cell->type = CELL_PATH;
+  }
+  else if (str_eq(cell_str, u8("##"), 2) ||
+           str_eq(cell_str, u8("  "), 2) ||
+           str_eq(cell_str, u8("``"), 2))
+  {
+    cell->type = CELL_WALL;
+  }
+  else if (str_eq(cell_str, u8("()"), 2))
+  {
+    cell->type = CELL_HOLE;
+  }
+  else if (str_eq(cell_str, u8("<>"), 2))
+  {
+    cell->type = CELL_SPLITTER;
+  }
+  else if (is_letter(cell_str[0]) && (is_letter(cell_str[1]) || is_num(cell_str[1])))
+  {
+    const u8 *end_function_name_f_ptr = f_ptr + 2;
+    const u8 *end_function_definition_f_ptr = parse_function_definition(functions, cell_str, end_function_name_f_ptr, f_end);
+    if (end_function_definition_f_ptr != end_function_name_f_ptr)
+    {
+      f_ptr = end_function_definition_f_ptr;
+    }
+    else
+    {
+      cell->type = CELL_FUNCTION;
+      cell->function_index = get_function_index(cell_str);
+    }
+
+  }
+  else if (str_eq(cell_str, u8("--"), 2))
+  {
+    cell->type = CELL_ONCE;
+  }
+  else if ((cell_str[0] == '*') && ((cell_str[1] == 'U') ||
+                                    (cell_str[1] == 'u')))
+  {
+    cell->type = CELL_UP_UNLESS_DETECT;
+  }
+  else if ((cell_str[0] == '*') && ((cell_str[1] == 'D') ||
+                                    (cell_str[1] == 'd')))
+  {
+    cell->type = CELL_DOWN_UNLESS_DETECT;
+  }
+  else if ((cell_str[0] == '*') && ((cell_str[1] == 'L') ||
+                                    (cell_str[1] == 'l')))
+  {
+    cell->type = CELL_LEFT_UNLESS_DETECT;
+  }
+  else if ((cell_str[0] == '*') && ((cell_str[1] == 'R') ||
+                                    (cell_str[1] == 'r')))
+  {
+    cell->type = CELL_RIGHT_UNLESS_DETECT;
+  }
+  else if (str_eq(cell_str, u8(">>"), 2))
+  {
+    cell->type = CELL_OUT;
+  }
+  else if (str_eq(cell_str, u8("<<"), 2))
+  {
+    cell->type = CELL_INP;
+  }
+  else if ((cell_str[0] == '%') && ((cell_str[1] == 'U') ||
+                                    (cell_str[1] == 'u')))
+  {
+    cell->type = CELL_UP;
+  }
+  else if ((cell_str[0] == '%') && ((cell_str[1] == 'D') ||
+                                    (cell_str[1] == 'd')))
+  {
+    cell->type = CELL_DOWN;
+  }
+  else if ((cell_str[0] == '%') && ((cell_str[1] == 'L') ||
+                                    (cell_str[1] == 'l')))
+  {
+    cell->type = CELL_LEFT;
+  }
+  else if ((cell_str[0] == '%') && ((cell_str[1] == 'R') ||
+                                    (cell_str[1] == 'r')))
+  {
+    cell->type = CELL_RIGHT;
+  }
+  else if (is_num(cell_str[0]) && is_num(cell_str[1]))
+  {
+    cell->type = CELL_PAUSE;
+
+    u32 digit0 = cell_str[0] - '0';
+    u32 digit1 = cell_str[1] - '0';
+    cell->pause = (10 * digit0) + digit1;
+  }
+
+  if (cell->type != CELL_NULL)
+  {
+    f_ptr += 2;
+  }
+
+  return f_ptr;
+}
+
+
+void
+old_parse(Maze *maze, Functions *functions, Memory *memory, const u8 *text, size_t size)
+{
+  clear_maze(maze);
+  zero(functions, Functions);
+
+  u32 x = 0;
+  u32 y = 0;
+
+  u8 cell_str[2] = {};
+  const u8 *f_ptr = text;
+  const u8 *f_end = f_ptr + size;
+  while (f_ptr < f_end)
+  {
+    cell_str[0] = f_ptr[0];
+    cell_str[1] = (f_ptr + 1 < f_end) ? f_ptr[1] : 0;
+
+    Cell new_cell = {};
+    new_cell.type = CELL_NULL;
+    f_ptr = old_parse_cell(maze, functions, cell_str, f_ptr, f_end, &new_cell);
+
+    if (new_cell.type != CELL_NULL)
+    {
+      Cell *cell = create_new_cell(maze, x, y, memory);
+
+      cell->type = new_cell.type;
+      cell->pause = new_cell.pause;
+      cell->function_index = new_cell.function_index;
+
+      log_s(L_Parser, u8("%.2s "), cell_str);
+      ++x;
+    }
+    else
+    {
+      if (cell_str[0] == '\n')
+      {
+        x = 0;
+        ++y;
+        log_s(L_Parser, u8("\n"));
+      }
+      f_ptr += 1;
+    }
+  }
+
+  log_s(L_Parser, u8("\n"));
+
+  link_all_cell_neighbours(maze);
+}
+
+
+//
+// Benchmark
+//
+
+enum BenchmarkParser
+{
+  PARSER_STR_EQ,
+  PARSER_TABLE,
+  PARSER_PARALLEL,
+
+  N_BENCHMARK_PARSERS
+};
+
+const u8 *PARSER_NAMES[] = {
+  u8("str_eq"),
+  u8("Table"),
+  u8("Parallel")
+};
+
+
+u32
+xorshift(u32 *state)
+{
+  u32 x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+
+// A square maze of a mix of every cell type, with some functions.
+u8 *
+generate_maze(u64 n_bytes, size_t *size)
+{
+  const u8 *cells[] = {
+    u8("^^"), u8(".."), u8(".."), u8(".."), u8("##"), u8("##"), u8("  "), u8("()"),
+    u8("<>"), u8("--"), u8("*U"), u8("*r"), u8(">>"), u8("<<"), u8("%D"), u8("%L"),
+    u8("07"), u8("42"), u8("AA"), u8("Bz"), u8("c9")
+  };
+  const u8 *functions = u8("AA -> =3\nBz -> IF <= 10 THEN %R ELSE %D\nc9 -> *= 2\n");
+
+  u32 side = (u32)sqrt(n_bytes / 3.0);
+  u64 functions_length = strlen((const char *)functions);
+  *size = (u64)side * side * 3 + functions_length;
+
+  u8 *result = (u8 *)malloc(*size);
+  u8 *ptr = result;
+
+  u32 random_state = 2463534242;
+  for (u32 y = 0; y < side; ++y)
+  {
+    for (u32 x = 0; x < side; ++x)
+    {
+      const u8 *cell = cells[xorshift(&random_state) % array_count(cells)];
+      ptr[0] = cell[0];
+      ptr[1] = cell[1];
+      ptr[2] = x == side - 1 ? '\n' : ' ';
+      ptr += 3;
+    }
+  }
+  memcpy(ptr, functions, functions_length);
+
+  return result;
+}
+
+
+u64
+maze_checksum(Maze *maze, Functions *functions)
+{
+  u64 result = functions->n_functions;
+
+  CellsIterator iter = {};
+  Cell *cell;
+  while ((cell = cells_iterator(maze, &iter)))
+  {
+    result = (result * 31) + (iter.x ^ (iter.y << 16)) + (cell->type << 24) + cell->pause + cell->neighbour_states;
+  }
+
+  return result;
+}
+
+
+int
+main(int argc, char const *argv[])
+{
+  register_game_logging_channels(GAME_LOGGING_CHANNEL_DEFINITIONS);
+
+  u32 n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  u32 first_maze_arg = 1;
+  if (argc > 2 && strcmp(argv[1], "--threads") == 0)
+  {
+    n_threads = atoi(argv[2]);
+    first_maze_arg = 3;
+  }
+
+  SimThreads sim_threads = {};
+  init_sim_threads(&sim_threads, n_threads);
+  ParseThreads parse_threads = {};
+  init_parse_threads(&parse_threads, &sim_threads);
+  printf("Parallel parsing on %u threads\n", get_n_sim_threads(&sim_threads));
+
+  u32 n_mazes = argc > first_maze_arg ? argc - first_maze_arg : 1;
+
+  printf("%-24s %-8s %10s %10s %10s\n", "maze", "parser", "MB", "ms", "MB/s");
+
+  for (u32 maze_index = 0;
+       maze_index < n_mazes;
+       ++maze_index)
+  {
+    const u8 *name;
+    const u8 *text;
+    size_t size;
+    File file;
+
+    if (argc > first_maze_arg)
+    {
+      name = (const u8 *)argv[first_maze_arg + maze_index];
+      if (!open_file(name, &file))
+      {
+        continue;
+      }
+      text = file.text;
+      size = file.size;
+    }
+    else
+    {
+      name = u8("generated");
+      text = generate_maze(megabytes_to_bytes(16), &size);
+    }
+
+    // NOTE: The chunks from the first parse are reused from the free
+    //         chain, so memory only needs to hold one maze.
+    Memory memory;
+    memory.total = 48 * size + megabytes_to_bytes(64);
+    memory.used = 0;
+    memory.memory = (u8 *)malloc(memory.total);
+
+    Maze *maze = push_struct(&memory, Maze);
+    zero(maze, Maze);
+    Functions *functions = push_struct(&memory, Functions);
+
+    u64 checksums[N_BENCHMARK_PARSERS];
+    for (u32 parser = PARSER_STR_EQ;
+         parser < N_BENCHMARK_PARSERS;
+         ++parser)
+    {
+      // Warm up, and fill the free chain
+      old_parse(maze, functions, &memory, text, size);
+
+      u32 n_runs = 3;
+      u64 best_us = MAX_U64;
+      for (u32 run = 0; run < n_runs; ++run)
+      {
+        u64 start = get_us();
+        if (parser == PARSER_STR_EQ)
+        {
+          old_parse(maze, functions, &memory, text, size);
+        }
+        else if (parser == PARSER_TABLE)
+        {
+          parse(maze, functions, &memory, text, size);
+        }
+        else
+        {
+          parse(maze, functions, &memory, text, size, &parse_threads);
+        }
+        u64 end = get_us();
+        best_us = min(best_us, end - start);
+      }
+
+      checksums[parser] = maze_checksum(maze, functions);
+
+      r64 megabytes = size / (r64)megabytes_to_bytes(1);
+      printf("%-24s %-8s %10.1f %10.1f %10.1f\n", name, PARSER_NAMES[parser],
+             megabytes, best_us / 1000.0, megabytes / (best_us / 1000000.0));
+    }
+
+    if (checksums[PARSER_STR_EQ] != checksums[PARSER_TABLE] ||
+        checksums[PARSER_STR_EQ] != checksums[PARSER_PARALLEL])
+    {
+      printf("Error: Parsed mazes differ.\n");
+    }
+
+    free(memory.memory);
+  }
+
+  stop_sim_threads(&sim_threads);
+  stop_parse_threads(&parse_threads);
+
+  return 0;
+}
\ No newline at end of file
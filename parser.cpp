@@ -1,9 +1,19 @@
+// Compares the text at f_ptr with str, without reading past f_end, see
+//   get_cell_pair().
+b32
+text_eq(const u8 *f_ptr, const u8 *f_end, const u8 *str, u32 length)
+{
+  b32 result = f_ptr + length <= f_end && str_eq(f_ptr, str, length);
+  return result;
+}
+
+
 const u8 *
-get_direction(const u8 *ptr, vec2 *result)
+get_direction(const u8 *ptr, const u8 *f_end, vec2 *result)
 {
   *result = STATIONARY;
 
-  if (ptr[0] == '%')
+  if (ptr + 2 <= f_end && ptr[0] == '%')
   {
     switch (ptr[1])
     {
@@ -39,7 +49,7 @@ get_direction(const u8 *ptr, vec2 *result)
 
 
 const u8 *
-parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *f_ptr, const u8 *f_end, Cell *cell)
+parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *f_ptr, const u8 *f_end)
 {
   u32 function_index = get_function_index(cell_str);
 
@@ -47,7 +57,7 @@ parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *
 
   consume_whitespace(f_ptr, f_end);
 
-  if (str_eq(f_ptr, u8("->"), 2))
+  if (text_eq(f_ptr, f_end, u8("->"), 2))
   {
     // Function Definition
     log(L_Parser, u8("Parsing function definition,"));
@@ -67,7 +77,7 @@ parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *
 
       consume_whitespace(f_ptr, f_end);
 
-      if (*f_ptr == '=')
+      if (text_eq(f_ptr, f_end, u8("="), 1))
       {
         log(L_Parser, u8("  Type: Assignment,"));
 
@@ -91,7 +101,8 @@ parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *
           function->type = FUNCTION_ASSIGNMENT;
         }
       }
-      else if ((f_ptr[0] == '+' ||
+      else if (f_ptr + 2 <= f_end &&
+               (f_ptr[0] == '+' ||
                 f_ptr[0] == '-' ||
                 f_ptr[0] == '*' ||
                 f_ptr[0] == '/') && f_ptr[1] == '=')
@@ -138,7 +149,7 @@ parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *
           }
         }
       }
-      else if (str_eq(f_ptr, u8("IF"), 2) || str_eq(f_ptr, u8("if"), 2))
+      else if (text_eq(f_ptr, f_end, u8("IF"), 2) || text_eq(f_ptr, f_end, u8("if"), 2))
       {
         log(L_Parser, u8("  Type: Conditional,"));
 
@@ -148,32 +159,32 @@ parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *
         FunctionType conditional_func_type;
         b32 valid_condition = true;
 
-        if (str_eq(f_ptr, u8("<="), 2))
+        if (text_eq(f_ptr, f_end, u8("<="), 2))
         {
           f_ptr += 2;
           conditional_func_type = FUNCTION_LESS_EQUAL;
         }
-        else if (*f_ptr == '<')
+        else if (text_eq(f_ptr, f_end, u8("<"), 1))
         {
           f_ptr += 1;
           conditional_func_type = FUNCTION_LESS;
         }
-        else if (str_eq(f_ptr, u8(">="), 2))
+        else if (text_eq(f_ptr, f_end, u8(">="), 2))
         {
           f_ptr += 2;
           conditional_func_type = FUNCTION_GREATER_EQUAL;
         }
-        else if (*f_ptr == '>')
+        else if (text_eq(f_ptr, f_end, u8(">"), 1))
         {
           f_ptr += 1;
           conditional_func_type = FUNCTION_GREATER;
         }
-        else if (str_eq(f_ptr, u8("=="), 2))
+        else if (text_eq(f_ptr, f_end, u8("=="), 2))
         {
           f_ptr += 2;
           conditional_func_type = FUNCTION_EQUAL;
         }
-        else if (str_eq(f_ptr, u8("!="), 2))
+        else if (text_eq(f_ptr, f_end, u8("!="), 2))
         {
           f_ptr += 2;
           conditional_func_type = FUNCTION_NOT_EQUAL;
@@ -203,7 +214,7 @@ parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *
 
             consume_whitespace(f_ptr, f_end);
 
-            if (!(str_eq(f_ptr, u8("THEN"), 4) || str_eq(f_ptr, u8("then"), 4)))
+            if (!(text_eq(f_ptr, f_end, u8("THEN"), 4) || text_eq(f_ptr, f_end, u8("then"), 4)))
             {
               log(L_Parser, u8("  Invalid function: Missing 'THEN' keyword."));
               function->type = FUNCTION_NULL;
@@ -214,7 +225,7 @@ parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *
               consume_whitespace(f_ptr, f_end);
 
               vec2 true_direction;
-              const u8 *end_true_direction_f_ptr = get_direction(f_ptr, &true_direction);
+              const u8 *end_true_direction_f_ptr = get_direction(f_ptr, f_end, &true_direction);
               if (end_true_direction_f_ptr == f_ptr)
               {
                 log(L_Parser, u8("  Invalid function: Missing 'THEN' direction."));
@@ -232,14 +243,14 @@ parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *
                 vec2 false_direction;
 
                 // ELSE is optional
-                if (str_eq(f_ptr, u8("ELSE"), 4) || str_eq(f_ptr, u8("else"), 4))
+                if (text_eq(f_ptr, f_end, u8("ELSE"), 4) || text_eq(f_ptr, f_end, u8("else"), 4))
                 {
                   else_exists = true;
 
                   f_ptr += 4;
                   consume_whitespace(f_ptr, f_end);
 
-                  const u8 *end_false_direction_f_ptr = get_direction(f_ptr, &false_direction);
+                  const u8 *end_false_direction_f_ptr = get_direction(f_ptr, f_end, &false_direction);
                   if (end_false_direction_f_ptr == f_ptr)
                   {
                     log(L_Parser, u8("Invalid function: Missing 'ELSE' direction."));
@@ -291,8 +302,34 @@ parse_function_definition(Functions *functions, const u8 cell_str[2], const u8 *
 }
 
 
+// Returns the end of the function definition after the function's
+//   name at f_ptr, or f_ptr if there isn't one, the same as
+//   parse_function_definition() without parsing it.
 const u8 *
-parse_cell(Maze *maze, Functions *functions, const u8 cell_str[2], const u8 *f_ptr, const u8 *f_end, Cell *cell)
+skip_function_definition(const u8 *f_ptr, const u8 *f_end)
+{
+  const u8 *start_f_ptr = f_ptr;
+
+  consume_whitespace(f_ptr, f_end);
+
+  if (text_eq(f_ptr, f_end, u8("->"), 2))
+  {
+    f_ptr += 2;
+    consume_until_newline(f_ptr, f_end);
+  }
+  else
+  {
+    f_ptr = start_f_ptr;
+  }
+
+  return f_ptr;
+}
+
+
+// Sets the cell's type, pause and function index from the cell's two
+//   characters, leaves it CELL_NULL if they aren't a cell.
+void
+classify_cell_pair(const u8 cell_str[2], Cell *cell)
 {
   if (str_eq(cell_str, u8("^^"), 2))
   {
@@ -318,18 +355,10 @@ parse_cell(Maze *maze, Functions *functions, const u8 cell_str[2], const u8 *f_p
   }
   else if (is_letter(cell_str[0]) && (is_letter(cell_str[1]) || is_num(cell_str[1])))
   {
-    const u8 *end_function_name_f_ptr = f_ptr + 2;
-    const u8 *end_function_definition_f_ptr = parse_function_definition(functions, cell_str, end_function_name_f_ptr, f_end, cell);
-    if (end_function_definition_f_ptr != end_function_name_f_ptr)
-    {
-      f_ptr = end_function_definition_f_ptr;
-    }
-    else
-    {
-      cell->type = CELL_FUNCTION;
-      cell->function_index = get_function_index(cell_str);
-    }
-
+    // NOTE: This may be the start of a function definition instead,
+    //         parse() checks.
+    cell->type = CELL_FUNCTION;
+    cell->function_index = get_function_index(cell_str);
   }
   else if (str_eq(cell_str, u8("--"), 2))
   {
@@ -391,78 +420,566 @@ parse_cell(Maze *maze, Functions *functions, const u8 cell_str[2], const u8 *f_p
     u32 digit1 = cell_str[1] - '0';
     cell->pause = (10 * digit0) + digit1;
   }
+}
+
+
+const CellToken *
+build_cell_tokens(CellToken *tokens)
+{
+  for (u32 pair = 0;
+       pair < N_CELL_TOKENS;
+       ++pair)
+  {
+    u8 cell_str[2] = {(u8)(pair & 0xff), (u8)(pair >> 8)};
+
+    Cell cell = {};
+    cell.type = CELL_NULL;
+    classify_cell_pair(cell_str, &cell);
+
+    CellToken *token = tokens + pair;
+    token->type = cell.type;
+    token->value = cell.type == CELL_FUNCTION ? cell.function_index : cell.pause;
+  }
+
+  return tokens;
+}
+
+
+const CellToken *
+get_cell_tokens()
+{
+  // NOTE: The table is built on first use, which C++11 makes thread
+  //         safe. It is never changed after, so it is shared between
+  //         sims.
+  static CellToken tokens[N_CELL_TOKENS];
+  static const CellToken *table = build_cell_tokens(tokens);
+
+  return table;
+}
+
+
+u32
+get_cell_pair(const u8 *f_ptr, const u8 *f_end)
+{
+  // NOTE: The text may be a caller's buffer rather than a mapped file,
+  //         so don't read past the end of it.
+  u32 result = f_ptr[0];
+  if (f_ptr + 1 < f_end)
+  {
+    result |= f_ptr[1] << 8;
+  }
+  return result;
+}
+
+
+// TODO: Parse comments!
+
+
+// Returns false if the text runs out before showing whether there is a
+//   function definition after the function name at f_ptr, or before the
+//   end of the definition's line.
+b32
+function_definition_complete(const u8 *f_ptr, const u8 *f_end)
+{
+  consume_whitespace(f_ptr, f_end);
 
-  if (cell->type != CELL_NULL)
+  b32 result = f_ptr + 2 <= f_end;
+  if (result && str_eq(f_ptr, u8("->"), 2))
   {
     f_ptr += 2;
+    consume_until_newline(f_ptr, f_end);
+    result = f_ptr < f_end;
+  }
+
+  return result;
+}
+
+
+// Creates the cells and parses the function definitions in the text,
+//   continuing from the position x, y.
+//
+// If more_text is set, the text is a window onto a longer text, so it
+//   stops before any cell or definition which isn't all in the window,
+//   and returns where it stopped.
+const u8 *
+lex_maze_text(Maze *maze, Functions *functions, Memory *memory, const u8 *f_ptr, const u8 *f_end, b32 more_text, u32 *x, u32 *y)
+{
+  const CellToken *tokens = get_cell_tokens();
+
+  while (f_ptr < f_end)
+  {
+    if (more_text && f_ptr + 1 == f_end)
+    {
+      break;
+    }
+
+    CellToken token = tokens[get_cell_pair(f_ptr, f_end)];
+
+    if (token.type == CELL_FUNCTION)
+    {
+      const u8 *end_function_name_f_ptr = f_ptr + 2;
+      if (more_text && !function_definition_complete(end_function_name_f_ptr, f_end))
+      {
+        break;
+      }
+
+      const u8 *end_function_definition_f_ptr = parse_function_definition(functions, f_ptr, end_function_name_f_ptr, f_end);
+      if (end_function_definition_f_ptr != end_function_name_f_ptr)
+      {
+        // NOTE: The definition ends at its newline, which is skipped
+        //         without starting a new row.
+        f_ptr = end_function_definition_f_ptr + 1;
+        continue;
+      }
+    }
+
+    if (token.type != CELL_NULL)
+    {
+      if (maze->row_runs)
+      {
+        add_cell_to_row_runs(maze, *x, *y, (CellType)token.type, token.value);
+      }
+      else
+      {
+        Cell *cell = create_new_cell(maze, *x, *y, memory);
+
+        update_maze_stats(maze, cell, *x, *y, (CellType)token.type);
+        update_cell_type_index(maze, cell, *x, *y, (CellType)token.type, memory);
+        cell->type = (CellType)token.type;
+        if (token.type == CELL_FUNCTION)
+        {
+          cell->function_index = token.value;
+        }
+        else
+        {
+          cell->pause = token.value;
+        }
+      }
+
+      log_s(L_Parser, u8("%.2s "), f_ptr);
+      f_ptr += 2;
+      ++*x;
+    }
+    else
+    {
+      if (f_ptr[0] == '\n')
+      {
+        *x = 0;
+        ++*y;
+        log_s(L_Parser, u8("\n"));
+      }
+      f_ptr += 1;
+    }
   }
 
   return f_ptr;
 }
 
 
-// TODO: Parse comments!
+void
+parse_serially(Maze *maze, Functions *functions, Memory *memory, const u8 *text, size_t size)
+{
+  clear_maze(maze);
+  zero(functions, Functions);
+
+  u32 x = 0;
+  u32 y = 0;
+  lex_maze_text(maze, functions, memory, text, text + size, false, &x, &y);
+
+  log_s(L_Parser, u8("\n"));
+
+  link_all_cell_neighbours(maze);
+}
 
 
-bool
-parse(Maze *maze, Functions *functions, Memory *memory, const u8 *filename)
+// Parses the text a window at a time, so none of the file needs to be
+//   mapped or held in memory.
+b32
+parse_streamed(Maze *maze, Functions *functions, Memory *memory, StreamedFile *file)
 {
-  bool success = true;
+  b32 success = true;
 
   clear_maze(maze);
   zero(functions, Functions);
 
-  File file;
-  success &= open_file(filename, &file);
-  if (success)
+  // NOTE: The window is left in the arena. parse_function_definition()
+  //         can look a few bytes past the end of a definition, so the
+  //         window is padded with zeros.
+  u32 window_size = STREAMED_PARSE_WINDOW_SIZE;
+  u8 *window = push_structs(memory, u8, window_size + STREAMED_PARSE_WINDOW_PADDING);
+
+  u32 x = 0;
+  u32 y = 0;
+
+  u64 offset = 0;
+  u32 carried_length = 0;
+  while (true)
   {
-    maze->tree.bounds = (Rectangle){(vec2){0, 0}, (vec2){MAX_MAZE_SIZE, MAX_MAZE_SIZE}};
+    u32 read_length = read_streamed_file(file, offset, window + carried_length, window_size - carried_length);
+    offset += read_length;
 
-    u32 x = 0;
-    u32 y = 0;
+    u32 window_length = carried_length + read_length;
+    zero_n(window + window_length, u8, STREAMED_PARSE_WINDOW_PADDING);
 
-    u8 cell_str[2] = {};
-    const u8 *f_ptr = file.text;
-    const u8 *f_end = f_ptr + file.size;
-    while (f_ptr < f_end)
-    {
-      cell_str[0] = f_ptr[0];
-      cell_str[1] = f_ptr[1];
+    b32 more_text = offset < file->size && read_length != 0;
+    const u8 *window_end = window + window_length;
+    const u8 *lexed_end = lex_maze_text(maze, functions, memory, window, window_end, more_text, &x, &y);
 
-      Cell new_cell = {};
-      new_cell.type = CELL_NULL;
-      f_ptr = parse_cell(maze, functions, cell_str, f_ptr, f_end, &new_cell);
+    if (!more_text)
+    {
+      break;
+    }
 
-      if (new_cell.type != CELL_NULL)
+    // Carry what wasn't lexed on to the next window
+    carried_length = window_end - lexed_end;
+    if (carried_length == window_size)
+    {
+      // The window is all one function name, and what follows it
+      const u8 *after_function_name = window + 2;
+      consume_whitespace(after_function_name, window_end);
+      if (after_function_name + 2 <= window_end &&
+          str_eq(after_function_name, u8("->"), 2))
       {
-        Cell *cell = create_new_cell(maze, x, y, memory);
+        printf("Error: Function definition at byte %lu is longer than the parse window.\n", offset - carried_length);
+        success = false;
+        break;
+      }
 
-        cell->type = new_cell.type;
-        cell->pause = new_cell.pause;
-        cell->function_index = new_cell.function_index;
+      // NOTE: Blank cells after a function name can't be told apart from
+      //         the whitespace before a definition, so the window grows
+      //         until it shows which they are. The old window is left in
+      //         the arena, like the chunk hash.
+      window_size *= 2;
+      u8 *new_window = push_structs(memory, u8, window_size + STREAMED_PARSE_WINDOW_PADDING);
+      memcpy(new_window, window, carried_length);
+      window = new_window;
+    }
+    else
+    {
+      memmove(window, lexed_end, carried_length);
+    }
+  }
+
+  log(L_Parser, u8("Streamed %lu bytes of maze"), offset);
 
-        cell->name[0] = cell_str[0];
-        cell->name[1] = cell_str[1];
+  link_all_cell_neighbours(maze);
 
-        log_s(L_Parser, u8("%.2s "), cell_str);
-        ++x;
+  return success;
+}
+
+
+void
+init_parse_threads(ParseThreads *parse_threads, SimThreads *sim_threads)
+{
+  parse_threads->sim_threads = sim_threads;
+  pthread_mutex_init(&parse_threads->memory_mutex, 0);
+}
+
+
+void
+stop_parse_threads(ParseThreads *parse_threads)
+{
+  pthread_mutex_destroy(&parse_threads->memory_mutex);
+}
+
+
+struct ParseJob
+{
+  ParseThreads *parse_threads;
+  Maze *maze;
+  Memory *memory;
+  b32 create_cells;
+};
+
+
+Cell *
+create_parsed_cell(ParseJob *job, ParseSegment *segment, u32 x, u32 y)
+{
+  Maze *maze = &segment->maze;
+
+  if (!find_or_create_chunk(maze, x >> CELL_CHUNK_SIZE_BITS, y >> CELL_CHUNK_SIZE_BITS))
+  {
+    pthread_mutex_lock(&job->parse_threads->memory_mutex);
+
+    // Take chunks from the sim's maze's free chain while creating it
+    maze->free_chain = job->maze->free_chain;
+    find_or_create_chunk(maze, x >> CELL_CHUNK_SIZE_BITS, y >> CELL_CHUNK_SIZE_BITS, job->memory);
+    job->maze->free_chain = maze->free_chain;
+    maze->free_chain = 0;
+
+    pthread_mutex_unlock(&job->parse_threads->memory_mutex);
+  }
+
+  // NOTE: The chunk exists now, so this doesn't allocate
+  Cell *cell = find_or_create_cell(maze, x, y, job->memory);
+  return cell;
+}
+
+
+// Like create_parsed_cell(), the memory is only locked when the index
+//   needs to grow.
+void
+index_parsed_cell(ParseJob *job, ParseSegment *segment, u32 x, u32 y, CellType type)
+{
+  Maze *maze = &segment->maze;
+  CellTypeIndex *index = maze->type_indices + type;
+
+  if (CELL_TYPE_INDEXED[type] &&
+      index->n_positions == index->size)
+  {
+    pthread_mutex_lock(&job->parse_threads->memory_mutex);
+    add_to_cell_type_index(maze, type, x, y, job->memory);
+    pthread_mutex_unlock(&job->parse_threads->memory_mutex);
+  }
+  else
+  {
+    add_to_cell_type_index(maze, type, x, y, 0);
+  }
+}
+
+
+// Lexes one segment, skipping over the function definitions. The first
+//   pass counts the segment's rows, the second creates its cells.
+void
+lex_parse_segment(ParseJob *job, ParseSegment *segment)
+{
+  u32 x = segment->start_x;
+  u32 y = segment->start_y;
+
+  const CellToken *tokens = get_cell_tokens();
+
+  const u8 *f_ptr = segment->start;
+  const u8 *f_end = segment->end;
+  while (f_ptr < f_end)
+  {
+    CellToken token = tokens[get_cell_pair(f_ptr, f_end)];
+
+    if (token.type == CELL_FUNCTION)
+    {
+      const u8 *end_function_name_f_ptr = f_ptr + 2;
+      const u8 *end_function_definition_f_ptr = skip_function_definition(end_function_name_f_ptr, f_end);
+      if (end_function_definition_f_ptr != end_function_name_f_ptr)
+      {
+        if (!segment->first_definition)
+        {
+          segment->first_definition = f_ptr;
+        }
+
+        f_ptr = end_function_definition_f_ptr + 1;
+        continue;
       }
-      else
+    }
+
+    if (token.type != CELL_NULL)
+    {
+      if (job->create_cells)
       {
-        if (cell_str[0] == '\n')
+        Cell *cell = create_parsed_cell(job, segment, x, y);
+
+        update_maze_stats(&segment->maze, cell, x, y, (CellType)token.type);
+        index_parsed_cell(job, segment, x, y, (CellType)token.type);
+        cell->type = (CellType)token.type;
+        if (token.type == CELL_FUNCTION)
+        {
+          cell->function_index = token.value;
+        }
+        else
         {
-          x = 0;
-          ++y;
-          log_s(L_Parser, u8("\n"));
+          cell->pause = token.value;
         }
-        f_ptr += 1;
       }
+
+      f_ptr += 2;
+      ++x;
+    }
+    else
+    {
+      if (f_ptr[0] == '\n')
+      {
+        x = 0;
+        ++y;
+      }
+      f_ptr += 1;
+    }
+  }
+
+  if (!job->create_cells)
+  {
+    segment->n_rows = y - segment->start_y;
+    segment->end_x = x;
+  }
+}
+
+
+void
+lex_parse_segment_job(u32 thread_index, void *data)
+{
+  ParseJob *job = (ParseJob *)data;
+  lex_parse_segment(job, job->parse_threads->segments + thread_index);
+}
+
+
+void
+link_parse_segment_job(u32 thread_index, void *data)
+{
+  ParseJob *job = (ParseJob *)data;
+  ParseSegment *segment = job->parse_threads->segments + thread_index;
+
+  CellChunk *chunk = segment->first_link_chunk;
+  for (u32 chunk_index = 0;
+       chunk_index < segment->n_link_chunks;
+       ++chunk_index)
+  {
+    link_chunk_cell_neighbours(job->maze, chunk);
+    chunk = chunk->next_chunk;
+  }
+}
+
+
+// Parses the function definitions from f_ptr, in order, as
+//   parse_serially() does.
+void
+parse_function_definitions(Functions *functions, const u8 *f_ptr, const u8 *f_end)
+{
+  const CellToken *tokens = get_cell_tokens();
+
+  while (f_ptr < f_end)
+  {
+    CellToken token = tokens[get_cell_pair(f_ptr, f_end)];
+
+    if (token.type == CELL_FUNCTION)
+    {
+      const u8 *end_function_name_f_ptr = f_ptr + 2;
+      const u8 *end_function_definition_f_ptr = parse_function_definition(functions, f_ptr, end_function_name_f_ptr, f_end);
+      if (end_function_definition_f_ptr != end_function_name_f_ptr)
+      {
+        f_ptr = end_function_definition_f_ptr + 1;
+        continue;
+      }
+    }
+
+    f_ptr += token.type != CELL_NULL ? 2 : 1;
+  }
+}
+
+
+void
+parse_in_parallel(Maze *maze, Functions *functions, Memory *memory, const u8 *text, size_t size, ParseThreads *parse_threads)
+{
+  clear_maze(maze);
+  zero(functions, Functions);
+
+  SimThreads *sim_threads = parse_threads->sim_threads;
+  u32 n_segments = get_n_sim_threads(sim_threads);
+
+  // NOTE: The position after a newline is always the start of a cell
+  //         or a definition, newlines can't be part of either.
+  const u8 *text_end = text + size;
+  const u8 *segment_start = text;
+  for (u32 segment_index = 0;
+       segment_index < n_segments;
+       ++segment_index)
+  {
+    ParseSegment *segment = parse_threads->segments + segment_index;
+
+    const u8 *segment_end = text_end;
+    if (segment_index != n_segments - 1)
+    {
+      segment_end = text + (size * (segment_index + 1)) / n_segments;
+      if (segment_end < segment_start)
+      {
+        segment_end = segment_start;
+      }
+      const u8 *newline = (const u8 *)memchr(segment_end, '\n', text_end - segment_end);
+      segment_end = newline ? newline + 1 : text_end;
     }
 
-    log_s(L_Parser, u8("\n"));
+    segment->start = segment_start;
+    segment->end = segment_end;
+    segment->start_x = 0;
+    segment->start_y = 0;
+    segment->first_definition = 0;
 
-    close_file(&file);
+    segment_start = segment_end;
   }
 
-  return success;
+  ParseJob job = {parse_threads, maze, memory, false};
+  run_sim_threads(sim_threads, n_segments, lex_parse_segment_job, &job);
+
+  u32 x = 0;
+  u32 y = 0;
+  for (u32 segment_index = 0;
+       segment_index < n_segments;
+       ++segment_index)
+  {
+    ParseSegment *segment = parse_threads->segments + segment_index;
+    segment->start_x = x;
+    segment->start_y = y;
+
+    if (segment->n_rows)
+    {
+      x = segment->end_x;
+      y += segment->n_rows;
+    }
+    else
+    {
+      x += segment->end_x;
+    }
+  }
+
+  job.create_cells = true;
+  run_sim_threads(sim_threads, n_segments, lex_parse_segment_job, &job);
+
+  for (u32 segment_index = 0;
+       segment_index < n_segments;
+       ++segment_index)
+  {
+    ParseSegment *segment = parse_threads->segments + segment_index;
+    merge_maze_chunks(maze, memory, &segment->maze);
+
+    if (segment->first_definition)
+    {
+      parse_function_definitions(functions, segment->first_definition, segment->end);
+    }
+  }
+
+  CellChunk *chunk = maze->first_chunk;
+  for (u32 segment_index = 0;
+       segment_index < n_segments;
+       ++segment_index)
+  {
+    ParseSegment *segment = parse_threads->segments + segment_index;
+    segment->first_link_chunk = chunk;
+    segment->n_link_chunks = ((segment_index + 1) * maze->n_chunks) / n_segments - (segment_index * maze->n_chunks) / n_segments;
+
+    for (u32 chunk_index = 0;
+         chunk_index < segment->n_link_chunks;
+         ++chunk_index)
+    {
+      chunk = chunk->next_chunk;
+    }
+  }
+
+  run_sim_threads(sim_threads, n_segments, link_parse_segment_job, &job);
+
+  log(L_Parser, u8("Parsed maze on %u threads"), n_segments);
+}
+
+
+void
+parse(Maze *maze, Functions *functions, Memory *memory, const u8 *text, size_t size, ParseThreads *parse_threads = 0)
+{
+  // NOTE: Mazes stored as runs are always parsed serially, the runs are
+  //         added in order.
+  if (parse_threads &&
+      !maze->row_runs &&
+      get_n_sim_threads(parse_threads->sim_threads) > 1 &&
+      size >= MIN_PARALLEL_PARSE_SIZE)
+  {
+    parse_in_parallel(maze, functions, memory, text, size, parse_threads);
+  }
+  else
+  {
+    parse_serially(maze, functions, memory, text, size);
+  }
 }
\ No newline at end of file
@@ -1 +1,78 @@
 const u32 MAX_MAZE_SIZE = 10000;
+
+
+// Text mazes too big to map are parsed a window at a time, so the
+//   memory used is only the cells'. Function definitions have to fit
+//   in the window, which only grows for blank cells after a function
+//   name.
+const u64 MAX_MAPPED_MAZE_SIZE = MAX_S32;
+const u32 STREAMED_PARSE_WINDOW_SIZE = megabytes_to_bytes(1);
+const u32 STREAMED_PARSE_WINDOW_PADDING = 8;
+
+
+
+// Cells are lexed with a table indexed by each pair of characters,
+//   (second << 8) | first, which gives the pair's cell type and its
+//   pause or function index. CELL_NULL pairs aren't cells, and the
+//   first character is skipped.
+//
+// NOTE: Function names are CELL_FUNCTION, the parser checks if they
+//         are followed by a definition.
+
+const u32 N_CELL_TOKENS = 1 << 16;
+
+struct CellToken
+{
+  u8 type;
+  u16 value;
+};
+
+
+// Large mazes are parsed on the sim's threads:
+// - The text is split into a segment for each thread, at newlines
+// - Each thread lexes its segment to count the rows in it, so the
+//     position of each segment's first cell in the maze can be found
+// - Each thread lexes its segment again, creating the cells in its own
+//     Maze, then the Mazes' chunks are merged into the sim's maze in
+//     segment order
+// - The function definitions are parsed in order after the merge
+// - The chunks' neighbours are linked, split between the threads
+//
+// The result is the same as parsing the text in one pass, chunks are
+//   chained in the same order.
+
+const u64 MIN_PARALLEL_PARSE_SIZE = megabytes_to_bytes(1);
+
+
+struct ParseSegment
+{
+  const u8 *start;
+  const u8 *end;
+
+  // Found by the first pass, rows are started by newlines which aren't
+  //   the end of function definitions.
+  u32 n_rows;
+  u32 end_x;
+  const u8 *first_definition;
+
+  // Where the segment's first cell is in the maze
+  u32 start_x;
+  u32 start_y;
+
+  Maze maze;
+
+  CellChunk *first_link_chunk;
+  u32 n_link_chunks;
+};
+
+
+struct ParseThreads
+{
+  SimThreads *sim_threads;
+
+  // NOTE: The threads allocate their chunks from the arena and the
+  //         maze's free chain, which is only done with this held.
+  pthread_mutex_t memory_mutex;
+
+  ParseSegment segments[MAX_SIM_THREADS];
+};
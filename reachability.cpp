@@ -0,0 +1,296 @@
+ReachedChunk *
+find_reached_chunk(ReachedCells *reached, u32 chunk_x, u32 chunk_y)
+{
+  ReachedChunk *result = 0;
+
+  u32 slot = get_chunk_hash_slot(chunk_x, chunk_y, reached->hash_size);
+  while (reached->chunks[slot].chunk)
+  {
+    CellChunk *chunk = reached->chunks[slot].chunk;
+    if (chunk->chunk_x == chunk_x &&
+        chunk->chunk_y == chunk_y)
+    {
+      result = reached->chunks + slot;
+      break;
+    }
+    slot = (slot + 1) & (reached->hash_size - 1);
+  }
+
+  return result;
+}
+
+
+// Returns true if the cell hadn't been reached before
+b32
+mark_cell_reached(ReachedCells *reached, u32 x, u32 y)
+{
+  b32 result = false;
+
+  ReachedChunk *reached_chunk = find_reached_chunk(reached, x >> CELL_CHUNK_SIZE_BITS, y >> CELL_CHUNK_SIZE_BITS);
+  if (reached_chunk)
+  {
+    u32 cell_index = get_cell_index_in_chunk(x, y);
+    u32 *word = reached_chunk->reached + (cell_index / 32);
+    u32 bit = 1 << (cell_index % 32);
+
+    if (!(*word & bit))
+    {
+      *word |= bit;
+      result = true;
+    }
+  }
+
+  return result;
+}
+
+
+void
+push_reached_cell(ReachedCells *reached, Memory *memory, u32 x, u32 y)
+{
+  if (reached->stack_used == reached->stack_size)
+  {
+    // NOTE: The old stack is left in the arena, the caller gives all the
+    //         memory back at the end.
+    u32 new_stack_size = reached->stack_size ? 2 * reached->stack_size : INITIAL_REACH_STACK_SIZE;
+    CellPosition *new_stack = push_structs(memory, CellPosition, new_stack_size);
+    memcpy(new_stack, reached->stack, reached->stack_used * sizeof(CellPosition));
+
+    reached->stack = new_stack;
+    reached->stack_size = new_stack_size;
+  }
+
+  CellPosition *position = reached->stack + reached->stack_used++;
+  position->x = x;
+  position->y = y;
+}
+
+
+// Flood fills from the start cells over the walkable cells, marking the
+//   cells reached and their neighbours.
+void
+find_reached_cells(ReachedCells *reached, Maze *maze, CellTypeIndex *starts, Memory *memory)
+{
+  zero(reached, ReachedCells);
+
+  reached->hash_size = INITIAL_CHUNK_HASH_SIZE;
+  while (reached->hash_size < 2 * maze->n_chunks)
+  {
+    reached->hash_size *= 2;
+  }
+  reached->chunks = push_structs(memory, ReachedChunk, reached->hash_size);
+  zero_n(reached->chunks, ReachedChunk, reached->hash_size);
+
+  CellChunk *chunk = maze->first_chunk;
+  while (chunk)
+  {
+    u32 slot = get_chunk_hash_slot(chunk->chunk_x, chunk->chunk_y, reached->hash_size);
+    while (reached->chunks[slot].chunk)
+    {
+      slot = (slot + 1) & (reached->hash_size - 1);
+    }
+    reached->chunks[slot].chunk = chunk;
+
+    chunk = chunk->next_chunk;
+  }
+
+  for (u32 start_index = 0;
+       start_index < starts->n_positions;
+       ++start_index)
+  {
+    CellPosition *start = starts->positions + start_index;
+    if (mark_cell_reached(reached, start->x, start->y))
+    {
+      push_reached_cell(reached, memory, start->x, start->y);
+    }
+  }
+
+  while (reached->stack_used)
+  {
+    CellPosition position = reached->stack[--reached->stack_used];
+    Cell *cell = get_cell(maze, position.x, position.y);
+
+    for (u32 neighbour = 0;
+         neighbour < N_CELL_NEIGHBOURS;
+         ++neighbour)
+    {
+      CellConnectedState state = get_neighbour_state(cell, (CellNeighbour)neighbour);
+      if (state != UNCONNECTED)
+      {
+        vec2 direction = CAR_DIRECTION_VECTORS[neighbour];
+        u32 neighbour_x = position.x + (s32)direction.x;
+        u32 neighbour_y = position.y + (s32)direction.y;
+
+        // NOTE: Unwalkable neighbours are kept, but not filled from.
+        if (mark_cell_reached(reached, neighbour_x, neighbour_y) &&
+            state == WALKABLE)
+        {
+          push_reached_cell(reached, memory, neighbour_x, neighbour_y);
+        }
+      }
+    }
+  }
+}
+
+
+// Removes the cells no car can reach, returns the number of cells removed
+u64
+prune_unreachable_cells(Maze *maze, Memory *memory)
+{
+  u64 n_pruned = 0;
+
+  if (maze->row_runs)
+  {
+    log(L_Reachability, u8("Mazes stored as runs aren't pruned"));
+  }
+  else
+  {
+    // NOTE: Found before the memory is noted, the index might be rebuilt.
+    CellTypeIndex *starts = get_cell_type_index(maze, CELL_START, memory);
+
+    // NOTE: The reached cells are only needed here, so their memory is
+    //         given back afterwards.
+    size_t memory_used = memory->used;
+
+    ReachedCells reached;
+    find_reached_cells(&reached, maze, starts, memory);
+
+    b32 removed_chunks = false;
+    CellChunk **link = &maze->first_chunk;
+    while (*link)
+    {
+      CellChunk *chunk = *link;
+      ReachedChunk *reached_chunk = find_reached_chunk(&reached, chunk->chunk_x, chunk->chunk_y);
+
+      for (u32 word_index = 0;
+           word_index < CELLS_PER_CHUNK / 32;
+           ++word_index)
+      {
+        u32 pruned_cells = chunk->cell_exists[word_index] & ~reached_chunk->reached[word_index];
+        for (u32 bit = 0;
+             pruned_cells;
+             ++bit, pruned_cells >>= 1)
+        {
+          if (pruned_cells & 1)
+          {
+            Cell *cell = chunk->cells + (word_index * 32) + bit;
+            --maze->stats.n_cells_of_type[cell->type];
+            --maze->stats.n_cells;
+            --chunk->n_cells;
+            ++n_pruned;
+          }
+        }
+        chunk->cell_exists[word_index] &= reached_chunk->reached[word_index];
+      }
+
+      if (chunk->n_cells == 0)
+      {
+        *link = chunk->next_chunk;
+        chunk->next_chunk = maze->free_chain;
+        maze->free_chain = chunk;
+        --maze->n_chunks;
+        removed_chunks = true;
+      }
+      else
+      {
+        link = &chunk->next_chunk;
+      }
+    }
+
+    if (removed_chunks)
+    {
+      zero_n(maze->chunk_hash, CellChunk *, maze->chunk_hash_size);
+      CellChunk *chunk = maze->first_chunk;
+      while (chunk)
+      {
+        insert_chunk_into_hash(maze->chunk_hash, maze->chunk_hash_size, chunk);
+        chunk = chunk->next_chunk;
+      }
+      maze->last_chunk = 0;
+    }
+
+    if (n_pruned)
+    {
+      maze->stats.bounds_stale = true;
+
+      // Take the pruned cells out of the type indices
+      for (u32 type = 0;
+           type < N_CELL_TYPES && !maze->type_indices_stale;
+           ++type)
+      {
+        CellTypeIndex *index = maze->type_indices + type;
+
+        u32 n_kept = 0;
+        for (u32 position_index = 0;
+             position_index < index->n_positions;
+             ++position_index)
+        {
+          CellPosition *position = index->positions + position_index;
+          if (get_cell(maze, position->x, position->y))
+          {
+            index->positions[n_kept++] = *position;
+          }
+        }
+        index->n_positions = n_kept;
+      }
+    }
+
+    memory->used = memory_used;
+
+    log(L_Reachability, u8("Pruned %lu unreachable cells, %u chunks left"), n_pruned, maze->n_chunks);
+  }
+
+  return n_pruned;
+}
+
+
+// Returns the chunks with no cells any car can reach, in an array left in
+//   the arena, without changing the maze.
+CellChunk **
+find_unreachable_chunks(Maze *maze, Memory *memory, u32 *n_unreachable_chunks)
+{
+  CellChunk **result = 0;
+  *n_unreachable_chunks = 0;
+
+  if (maze->row_runs)
+  {
+    log(L_Reachability, u8("Mazes stored as runs aren't searched for unreachable chunks"));
+  }
+  else
+  {
+    // NOTE: Found before the memory is noted, the index might be rebuilt.
+    CellTypeIndex *starts = get_cell_type_index(maze, CELL_START, memory);
+    result = push_structs(memory, CellChunk *, maze->n_chunks);
+
+    size_t memory_used = memory->used;
+
+    ReachedCells reached;
+    find_reached_cells(&reached, maze, starts, memory);
+
+    CellChunk *chunk = maze->first_chunk;
+    while (chunk)
+    {
+      ReachedChunk *reached_chunk = find_reached_chunk(&reached, chunk->chunk_x, chunk->chunk_y);
+
+      b32 chunk_reached = false;
+      for (u32 word_index = 0;
+           word_index < CELLS_PER_CHUNK / 32 && !chunk_reached;
+           ++word_index)
+      {
+        chunk_reached = (chunk->cell_exists[word_index] & reached_chunk->reached[word_index]) != 0;
+      }
+
+      if (!chunk_reached)
+      {
+        result[(*n_unreachable_chunks)++] = chunk;
+      }
+
+      chunk = chunk->next_chunk;
+    }
+
+    memory->used = memory_used;
+
+    log(L_Reachability, u8("Found %u unreachable chunks of %u"), *n_unreachable_chunks, maze->n_chunks);
+  }
+
+  return result;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+// Pruning unreachable cells
+//
+// Generated mazes often have large areas which no car can ever get to.
+//   Cars only move onto walkable neighbours, so every cell a car can be
+//   on is found by a flood fill over the walkable cells from the start
+//   cells. When prune_unreachable is set, the rest of the cells are
+//   removed as the maze is loaded, so they aren't analysed, compiled or
+//   iterated over.
+//
+// - The cells next to reached cells are kept too, so the reached cells'
+//     neighbours, and their neighbour states, are as they were
+// - Chunks left with no cells are put on the free chain
+// - Mazes stored as runs aren't pruned, the fill would build all of
+//     their chunks
+//
+// NOTE: Pruning is only for running mazes, the GUI keeps all the cells so
+//         they can be edited and saved. It draws each chunk with no
+//         reachable cells as one background instead, found by
+//         find_unreachable_chunks().
+
+
+const u32 INITIAL_REACH_STACK_SIZE = 1024;
+
+
+struct ReachedChunk
+{
+  CellChunk *chunk;
+  u32 reached[CELLS_PER_CHUNK / 32];
+};
+
+
+struct ReachedCells
+{
+  // Open addressed hash table of the maze's chunks, keyed by position
+  ReachedChunk *chunks;
+  u32 hash_size;
+
+  // The reached walkable cells whose neighbours haven't been looked at
+  CellPosition *stack;
+  u32 stack_used;
+  u32 stack_size;
+};
\ No newline at end of file
@@ -2,105 +2,130 @@ const u32 CELL_LENGTH = 3;
 const u32 LINE_BREAK_LENGTH = 1;
 
 
+vec2
+get_maze_size(Maze *maze)
+{
+  MazeBounds bounds = get_maze_bounds(maze);
+
+  vec2 result = Vec2(bounds.max_x - bounds.min_x + 1,
+                     bounds.max_y - bounds.min_y + 1);
+
+  return result;
+}
+
+
 void
-find_min_max(QuadTree *tree, vec2 *most_left, vec2 *most_top, vec2 *most_right, vec2 *most_bottom)
+flush_serialize_buffer(SerializeBuffer *out)
 {
-  if (tree)
+  if (!write_streamed_file(&out->file, out->offset, out->buffer, out->used))
   {
-    for (u32 cell_index = 0;
-         cell_index < tree->used;
-         ++cell_index)
-    {
-      Cell *cell = tree->cells + cell_index;
+    out->error = true;
+  }
+  out->offset += out->used;
+  out->used = 0;
+}
 
-      if (cell->type != CELL_NULL)
-      {
-        if (cell->x < most_left->x)
-        {
-          *most_left = Vec2(cell->x, cell->y);
-        }
-        if (cell->y < most_top->y)
-        {
-          *most_top = Vec2(cell->x, cell->y);
-        }
-        if (cell->x > most_right->x)
-        {
-          *most_right = Vec2(cell->x, cell->y);
-        }
-        if (cell->y > most_bottom->y)
-        {
-          *most_bottom = Vec2(cell->x, cell->y);
-        }
-      }
-    }
 
-    find_min_max(tree->top_left, most_left, most_top, most_right, most_bottom);
-    find_min_max(tree->top_right, most_left, most_top, most_right, most_bottom);
-    find_min_max(tree->bottom_left, most_left, most_top, most_right, most_bottom);
-    find_min_max(tree->bottom_right, most_left, most_top, most_right, most_bottom);
+// Returns space for length bytes in the buffer, flushing it if needed
+u8 *
+get_serialize_space(SerializeBuffer *out, u32 length)
+{
+  assert(length <= SERIALIZE_BUFFER_SIZE);
+
+  if (out->used + length > SERIALIZE_BUFFER_SIZE)
+  {
+    flush_serialize_buffer(out);
   }
+
+  u8 *result = out->buffer + out->used;
+  out->used += length;
+
+  return result;
 }
 
 
 void
-write_cells(QuadTree *tree, u8 *file, u32 width, u32 height, vec2 maze_origin, Functions *functions)
+serialize_cell(u8 *file_pos, Cell *cell, Functions *functions)
 {
-  if (tree)
+  if (cell == 0 || cell->type == CELL_NULL)
   {
-    for (u32 cell_index = 0;
-         cell_index < tree->used;
-         ++cell_index)
-    {
-      Cell *cell = tree->cells + cell_index;
+    file_pos[0] = ' ';
+    file_pos[1] = ' ';
+  }
+  else if (cell->type == CELL_FUNCTION)
+  {
+    Function *function = functions->hash_table + cell->function_index;
+    memcpy(file_pos, function->name, 2);
+  }
+  else if (cell->type == CELL_PAUSE)
+  {
+    u8 pause_text[3];
+    formatted_string(pause_text, 3, u8("%02d"), cell->pause);
+    memcpy(file_pos, pause_text, 2);
+  }
+  else
+  {
+    const u8 *text = CELL_TYPE_TXT[cell->type];
+    memcpy(file_pos, text, 2);
+  }
 
-      u32 rel_cell_pos_x = (u32)((s32)cell->x - (s32)maze_origin.x);
-      u32 rel_cell_pos_y = (u32)((s32)cell->y - (s32)maze_origin.y);
+  file_pos[2] = ' ';
+}
 
-      u32 n_line_breaks = rel_cell_pos_y*LINE_BREAK_LENGTH;
 
-      u32 cell_file_offset = CELL_LENGTH*(rel_cell_pos_x + (rel_cell_pos_y * width)) + n_line_breaks;
-      u8 *file_pos = file + cell_file_offset;
+// Writes the cells from min_x to max_x of a row, looking up each chunk
+//   once.
+//
+// NOTE: The positions are u64 so the loops can't overflow at the edge
+//         of the grid.
+void
+write_cell_range(SerializeBuffer *out, Maze *maze, Functions *functions, u64 y, u64 min_x, u64 max_x)
+{
+  u64 x = min_x;
+  while (x <= max_x)
+  {
+    CellChunk *chunk = find_chunk_in_hash(maze, x >> CELL_CHUNK_SIZE_BITS, y >> CELL_CHUNK_SIZE_BITS);
+    u64 chunk_end_x = min(x | CELL_CHUNK_MASK, max_x);
 
-      if (cell->type == CELL_FUNCTION)
-      {
-        Function *function = functions->hash_table + cell->function_index;
-        memcpy(file_pos, function->name, 2);
-      }
-      else if (cell->type == CELL_PAUSE)
+    u8 *file_pos = get_serialize_space(out, CELL_LENGTH * (chunk_end_x - x + 1));
+    for (;
+         x <= chunk_end_x;
+         ++x)
+    {
+      Cell *cell = 0;
+      Cell run_cell;
+      if (chunk)
       {
-        formatted_string(file_pos, 3, u8("%02d"), cell->pause);
+        u32 cell_index = get_cell_index_in_chunk(x, y);
+        if (chunk_cell_exists(chunk, cell_index))
+        {
+          cell = chunk->cells + cell_index;
+        }
       }
-      else if (cell->type != CELL_NULL)
+      else if (maze->row_runs && get_row_runs_cell(maze->row_runs, x, y, &run_cell))
       {
-        const u8 *text = CELL_TYPE_TXT[cell->type];
-        memcpy(file_pos, text, 2);
+        // NOTE: Chunks which haven't been built are written from the runs
+        //         without building them.
+        cell = &run_cell;
       }
 
-      file_pos[2] = ' ';
+      serialize_cell(file_pos, cell, functions);
+      file_pos += CELL_LENGTH;
     }
-
-    write_cells(tree->top_left, file, width, height, maze_origin, functions);
-    write_cells(tree->top_right, file, width, height, maze_origin, functions);
-    write_cells(tree->bottom_left, file, width, height, maze_origin, functions);
-    write_cells(tree->bottom_right, file, width, height, maze_origin, functions);
   }
 }
 
 
-vec2
-get_maze_size(Maze *maze)
+void
+write_cells(SerializeBuffer *out, Maze *maze, Functions *functions, MazeBounds bounds)
 {
-  vec2 most_left   = Vec2(maze->tree.cells[maze->tree.used-1].x, maze->tree.cells[maze->tree.used-1].y);
-  vec2 most_top    = most_left;
-  vec2 most_right  = most_left;
-  vec2 most_bottom = most_left;
-
-  find_min_max(&maze->tree, &most_left, &most_top, &most_right, &most_bottom);
-
-  vec2 result = Vec2((u32)(most_right - most_left).x + 1,
-                     (u32)(most_bottom - most_top).y + 1);
-
-  return result;
+  for (u64 y = bounds.min_y;
+       y <= bounds.max_y;
+       ++y)
+  {
+    write_cell_range(out, maze, functions, y, bounds.min_x, bounds.max_x);
+    *get_serialize_space(out, LINE_BREAK_LENGTH) = '\n';
+  }
 }
 
 
@@ -169,98 +194,201 @@ serialize_function(u8 buffer[MAX_FUNC_LENGTH], Function *function)
 }
 
 
-void
-serialize_maze(Maze *maze, Functions *functions, const u8 *filename)
+// frame_memory is only used for the write buffer
+b32
+serialize_maze(Maze *maze, Functions *functions, const u8 *filename, Memory *frame_memory, MazeEdits *edits = 0)
 {
-  // TMP: For testing without overwriting
-#if 0
-  ((u8 *)filename)[0] = '_';
-#endif
+  MazeBounds bounds = get_maze_bounds(maze);
 
-  vec2 most_left   = Vec2(maze->tree.cells[maze->tree.used-1].x,
-                          maze->tree.cells[maze->tree.used-1].y);
-  vec2 most_top    = most_left;
-  vec2 most_right  = most_left;
-  vec2 most_bottom = most_left;
+  SerializeBuffer out = {};
+  if (!open_streamed_file(filename, &out.file, STREAMED_FILE_WRITE))
+  {
+    out.error = true;
+  }
+  else
+  {
+    out.buffer = push_structs(frame_memory, u8, SERIALIZE_BUFFER_SIZE);
+
+    log(L_Serializer, u8("Serializing maze"));
 
-  find_min_max(&maze->tree, &most_left, &most_top, &most_right, &most_bottom);
+    write_cells(&out, maze, functions, bounds);
 
-  u32 width  = (u32)(most_right - most_left).x + 1;
-  u32 height = (u32)(most_bottom - most_top).y + 1;
+    // Line break for the gap between the maze and the function definitions
+    *get_serialize_space(&out, LINE_BREAK_LENGTH) = '\n';
 
-  u32 n_funcs = 8;
+    log(L_Serializer, u8("Serializing functions"));
+
+    for (u32 func_index = 0;
+         func_index < MAX_FUNCTIONS;
+         ++func_index)
+    {
+      Function *function = functions->hash_table + func_index;
 
-  u32 maze_length = CELL_LENGTH * width * height +
-                    LINE_BREAK_LENGTH * height;
-  u32 gap_length = 1;
-  u32 functions_length = MAX_FUNC_LENGTH * n_funcs;
+      if (function->type != FUNCTION_NULL)
+      {
+        log(L_Serializer, u8("Serializing function"));
 
-  u32 length = maze_length + gap_length + functions_length;
+        u8 function_buffer[MAX_FUNC_LENGTH];
+        u32 func_length = serialize_function(function_buffer, function);
+        memcpy(get_serialize_space(&out, func_length), function_buffer, func_length);
 
-  File file;
-  open_file(filename, &file, true, length);
+        log(L_Serializer, u8("%.*s"), func_length, function_buffer);
+      }
+    }
 
-  log(L_Serializer, u8("Serializing maze"));
+    flush_serialize_buffer(&out);
 
-  memset(file.write, ' ', length);
-  write_cells(&maze->tree, file.write, width, height, (vec2){most_left.x, most_top.y}, functions);
+    log(L_Serializer, u8("Wrote %lu bytes"), out.file.size);
 
-  // Add line breaks to maze
-  for (u32 line = 0;
-       line < height;
-       ++line)
-  {
-    u32 file_offset = (line+1) * width * CELL_LENGTH + line;
-    file.write[file_offset] = '\n';
+    if (edits)
+    {
+      edits->file_written = !out.error && stat_streamed_file(&out.file);
+      edits->bounds = bounds;
+      edits->file_size = out.file.size;
+      edits->file_modified_ns = out.file.modified_ns;
+    }
+
+    close_streamed_file(&out.file);
   }
 
-  // Add line breaks for gap between maze and function defs
-  for (u32 line = 0;
-       line < gap_length;
-       ++line)
+  if (out.error)
   {
-    u32 file_offset = maze_length + line;
-    file.write[file_offset] = '\n';
+    printf("Error: Couldn't save maze to \"%s\".\n", filename);
   }
 
-  log(L_Serializer, u8("Serializing functions"));
+  return !out.error;
+}
 
-  u8 tmp_function_buffer[MAX_FUNC_LENGTH];
-  u32 length_funcs_written = 0;
-  u32 functions_serialized = 0;
 
-  for (u32 func_index = 0;
-       func_index < MAX_FUNCTIONS;
-       ++func_index)
+// Changes the cell's type, recording the edit so the next save can
+//   rewrite just the changed cells.
+//
+// NOTE: The sim's own changes, CELL_ONCE cells becoming walls, don't go
+//         through here, they aren't edits to the maze.
+void
+edit_cell_type(MazeEdits *edits, Maze *maze, Cell *cell, u32 cell_x, u32 cell_y, CellType type)
+{
+  if (cell->type != type)
   {
-    Function *function = functions->hash_table + func_index;
-
-    if (function->type != FUNCTION_NULL)
+    if (cell->type == CELL_NULL || type == CELL_NULL)
     {
-      log(L_Serializer, u8("Serializing function"));
+      // NOTE: CELL_NULL cells aren't in the bounds, so this could move
+      //         the rows and columns in the file.
+      edits->full_save_needed = true;
+    }
+    else if (!edits->full_save_needed)
+    {
+      DirtyRow *dirty_row = 0;
+      for (u32 row_index = 0;
+           row_index < edits->n_dirty_rows;
+           ++row_index)
+      {
+        if (edits->dirty_rows[row_index].y == cell_y)
+        {
+          dirty_row = edits->dirty_rows + row_index;
+          break;
+        }
+      }
+
+      if (dirty_row)
+      {
+        dirty_row->min_x = min(dirty_row->min_x, cell_x);
+        dirty_row->max_x = max(dirty_row->max_x, cell_x);
+      }
+      else if (edits->n_dirty_rows < MAX_DIRTY_ROWS)
+      {
+        dirty_row = edits->dirty_rows + edits->n_dirty_rows++;
+        dirty_row->y = cell_y;
+        dirty_row->min_x = cell_x;
+        dirty_row->max_x = cell_x;
+      }
+      else
+      {
+        log(L_Serializer, u8("Too many dirty rows, the next save will write the whole maze"));
+        edits->full_save_needed = true;
+      }
+    }
+
+    set_cell_type(maze, cell, cell_x, cell_y, type);
+  }
+}
 
-      ++functions_serialized;
-      if (functions_serialized > n_funcs)
+
+// Rewrites the dirty rows' ranges in the file the last full save wrote.
+//   Returns false without changing the file if its layout isn't known.
+b32
+patch_maze_file(Maze *maze, Functions *functions, const u8 *filename, Memory *frame_memory, MazeEdits *edits)
+{
+  b32 success = false;
+
+  MazeBounds bounds = get_maze_bounds(maze);
+  if (edits->file_written && !edits->full_save_needed &&
+      bounds.min_x == edits->bounds.min_x && bounds.max_x == edits->bounds.max_x &&
+      bounds.min_y == edits->bounds.min_y && bounds.max_y == edits->bounds.max_y)
+  {
+    SerializeBuffer out = {};
+    if (open_streamed_file(filename, &out.file, STREAMED_FILE_CHANGE))
+    {
+      if (out.file.size != edits->file_size ||
+          out.file.modified_ns != edits->file_modified_ns)
       {
-        log(L_Serializer, u8("Error: Found more functions in hash table than told, ignoring extra functions."));
-        break;
+        log(L_Serializer, u8("Maze file changed since it was saved, writing the whole maze"));
       }
       else
       {
-        u32 file_pos = maze_length + gap_length + length_funcs_written;
+        out.buffer = push_structs(frame_memory, u8, SERIALIZE_BUFFER_SIZE);
+
+        log(L_Serializer, u8("Patching %u rows of the maze"), edits->n_dirty_rows);
 
-        u32 func_length = serialize_function(tmp_function_buffer, function);
-        memcpy(file.write + file_pos, tmp_function_buffer, func_length);
+        u64 row_length = ((u64)bounds.max_x - bounds.min_x + 1) * CELL_LENGTH + LINE_BREAK_LENGTH;
+        for (u32 row_index = 0;
+             row_index < edits->n_dirty_rows;
+             ++row_index)
+        {
+          DirtyRow *dirty_row = edits->dirty_rows + row_index;
 
-        log(L_Serializer, u8("%.*s"), func_length, tmp_function_buffer);
-        length_funcs_written += func_length;
+          flush_serialize_buffer(&out);
+          out.offset = (dirty_row->y - bounds.min_y) * row_length + (u64)(dirty_row->min_x - bounds.min_x) * CELL_LENGTH;
+          write_cell_range(&out, maze, functions, dirty_row->y, dirty_row->min_x, dirty_row->max_x);
+        }
+
+        flush_serialize_buffer(&out);
+
+        success = !out.error && stat_streamed_file(&out.file);
+        if (success)
+        {
+          edits->file_modified_ns = out.file.modified_ns;
+        }
+        else
+        {
+          // NOTE: The file could be partly written, so it has to be
+          //         written again in full.
+          edits->file_written = false;
+        }
       }
+
+      close_streamed_file(&out.file);
     }
   }
 
-  u32 length_written = maze_length + gap_length + length_funcs_written;
-  log(L_Serializer, u8("Overestimated bytes: %d"), length - length_written);
-
-  close_file(&file, length_written);
+  return success;
 }
 
+
+b32
+save_maze(Maze *maze, Functions *functions, const u8 *filename, Memory *frame_memory, MazeEdits *edits)
+{
+  b32 success = patch_maze_file(maze, functions, filename, frame_memory, edits);
+  if (!success)
+  {
+    success = serialize_maze(maze, functions, filename, frame_memory, edits);
+  }
+
+  if (success)
+  {
+    edits->full_save_needed = false;
+    edits->n_dirty_rows = 0;
+  }
+
+  return success;
+}
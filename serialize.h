@@ -0,0 +1,47 @@
+// Mazes are saved a row at a time through a fixed size buffer, so the
+//   memory used doesn't depend on the size of the maze. Cells missing
+//   from the maze's bounding box are written as spaces.
+//
+// Edits to cells are recorded by row, so saving an edited maze only
+//   rewrites the rows' changed ranges in place. Every cell is the same
+//   length in the file, so this only needs the bounds to be unchanged,
+//   and the file to still be the one the last full save wrote, which is
+//   checked by its size and modified time. The first save after loading
+//   is always a full save, as the layout of the loaded file isn't known.
+
+const u32 SERIALIZE_BUFFER_SIZE = kilobytes_to_bytes(256);
+
+
+struct SerializeBuffer
+{
+  StreamedFile file;
+  u8 *buffer;
+  u64 offset;
+  u32 used;
+  b32 error;
+};
+
+
+const u32 MAX_DIRTY_ROWS = 1024;
+
+
+struct DirtyRow
+{
+  u32 y;
+  u32 min_x;
+  u32 max_x;
+};
+
+
+struct MazeEdits
+{
+  // The file written by the last full save
+  b32 file_written;
+  MazeBounds bounds;
+  u64 file_size;
+  u64 file_modified_ns;
+
+  b32 full_save_needed;
+  u32 n_dirty_rows;
+  DirtyRow dirty_rows[MAX_DIRTY_ROWS];
+};
\ No newline at end of file
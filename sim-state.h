@@ -0,0 +1,34 @@
+// The front end is told about things it needs to deal with through
+//   the SimState:
+// - Cars which reached an input cell this tick, by id
+// - The number of values output so far, and the last one
+
+const u32 INITIAL_SIM_INPUT_REQUESTS_SIZE = 16;
+
+
+struct SimState
+{
+  Maze maze;
+  Functions functions;
+  Cars cars;
+  CarsTick cars_tick;
+  Corridors corridors;
+  Loops loops;
+  SimThreads sim_threads;
+  ParseThreads parse_threads;
+
+  u32 sim_steps;
+
+  b32 prune_unreachable;
+  u64 n_pruned_cells;
+
+  u32 *input_car_ids;
+  u32 n_input_car_ids;
+  u32 input_car_ids_size;
+
+  u64 n_outputs;
+  s32 last_output;
+
+  SimOutputCallback output_callback;
+  void *output_user_data;
+};
\ No newline at end of file
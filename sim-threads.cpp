@@ -0,0 +1,160 @@
+void *
+sim_thread_main(void *data)
+{
+  SimThread *thread = (SimThread *)data;
+  SimThreads *pool = thread->pool;
+
+  u32 last_job_generation = 0;
+
+  while (true)
+  {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->job_generation == last_job_generation)
+    {
+      pthread_cond_wait(&pool->job_start, &pool->mutex);
+    }
+    last_job_generation = pool->job_generation;
+
+    if (pool->quit)
+    {
+      pthread_mutex_unlock(&pool->mutex);
+      break;
+    }
+
+    SimThreadJob job = pool->job;
+    void *job_data = pool->job_data;
+    u32 job_n_threads = pool->job_n_threads;
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (thread->index < job_n_threads)
+    {
+      job(thread->index, job_data);
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    --pool->threads_working;
+    if (pool->threads_working == 0)
+    {
+      pthread_cond_signal(&pool->job_done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+  }
+
+  return 0;
+}
+
+
+b32
+init_sim_threads(SimThreads *pool, u32 n_threads)
+{
+  b32 success = true;
+
+  if (n_threads > MAX_SIM_THREADS)
+  {
+    log(L_SimThreads, u8("Clamping %u threads to %u"), n_threads, MAX_SIM_THREADS);
+    n_threads = MAX_SIM_THREADS;
+  }
+
+  pool->n_threads = 1;
+  pool->job_generation = 0;
+  pool->threads_working = 0;
+  pool->quit = false;
+
+  if (n_threads > 1)
+  {
+    pthread_mutex_init(&pool->mutex, 0);
+    pthread_cond_init(&pool->job_start, 0);
+    pthread_cond_init(&pool->job_done, 0);
+
+    // Thread 0 is the calling thread
+    for (u32 thread_index = 1;
+         thread_index < n_threads;
+         ++thread_index)
+    {
+      SimThread *thread = pool->threads + thread_index;
+      thread->pool = pool;
+      thread->index = thread_index;
+
+      if (pthread_create(&thread->handle, 0, sim_thread_main, thread) != 0)
+      {
+        printf("Error: Couldn't create sim thread %u.\n", thread_index);
+        success = false;
+        break;
+      }
+
+      pool->n_threads = thread_index + 1;
+    }
+  }
+
+  log(L_SimThreads, u8("Running sim on %u threads"), pool->n_threads);
+
+  return success;
+}
+
+
+u32
+get_n_sim_threads(SimThreads *pool)
+{
+  u32 result = max(pool->n_threads, (u32)1);
+  return result;
+}
+
+
+void
+run_sim_threads(SimThreads *pool, u32 n_threads, SimThreadJob job, void *data)
+{
+  assert(n_threads <= get_n_sim_threads(pool));
+
+  if (n_threads <= 1)
+  {
+    // Don't wake the other threads for nothing
+    job(0, data);
+  }
+  else
+  {
+    pthread_mutex_lock(&pool->mutex);
+    pool->job = job;
+    pool->job_data = data;
+    pool->job_n_threads = n_threads;
+    pool->threads_working = pool->n_threads - 1;
+    ++pool->job_generation;
+    pthread_cond_broadcast(&pool->job_start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    job(0, data);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->threads_working != 0)
+    {
+      pthread_cond_wait(&pool->job_done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+  }
+}
+
+
+void
+stop_sim_threads(SimThreads *pool)
+{
+  if (pool->n_threads > 1)
+  {
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    ++pool->job_generation;
+    pthread_cond_broadcast(&pool->job_start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (u32 thread_index = 1;
+         thread_index < pool->n_threads;
+         ++thread_index)
+    {
+      pthread_join(pool->threads[thread_index].handle, 0);
+    }
+
+    pthread_cond_destroy(&pool->job_done);
+    pthread_cond_destroy(&pool->job_start);
+    pthread_mutex_destroy(&pool->mutex);
+  }
+
+  pool->n_threads = 1;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+const u32 MAX_SIM_THREADS = 64;
+
+
+// A job is run once on each of the first n threads, with the calling
+//   thread as thread_index 0, run_sim_threads() returns when all threads
+//   have finished the job.
+//
+// stop_sim_threads() joins the threads, so a pool can be thrown away
+//   when the sim is embedded in a longer running process.
+typedef void (*SimThreadJob)(u32 thread_index, void *data);
+
+
+struct SimThreads;
+
+struct SimThread
+{
+  SimThreads *pool;
+  u32 index;
+  pthread_t handle;
+};
+
+
+struct SimThreads
+{
+  // NOTE: n_threads includes the calling thread, 0 or 1 runs all jobs
+  //         serially on the calling thread.
+  u32 n_threads;
+  SimThread threads[MAX_SIM_THREADS];
+
+  pthread_mutex_t mutex;
+  pthread_cond_t job_start;
+  pthread_cond_t job_done;
+
+  SimThreadJob job;
+  void *job_data;
+  u32 job_n_threads;
+  u32 job_generation;
+  u32 threads_working;
+
+  b32 quit;
+};
\ No newline at end of file
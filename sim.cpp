@@ -0,0 +1,154 @@
+SimState *
+init_sim(Memory *memory, SimOptions *options)
+{
+  register_game_logging_channels(GAME_LOGGING_CHANNEL_DEFINITIONS);
+
+  SimState *sim = push_struct(memory, SimState);
+  zero(sim, SimState);
+
+  // NOTE: Corridors are found from every cell, which would build all the
+  //         maze's chunks.
+  sim->corridors.enabled = options->compress_corridors && !options->compress_rows;
+  sim->loops.enabled = options->accelerate_loops;
+  sim->cars.merge_identical = options->merge_identical_cars;
+  sim->maze.track_active_chunks = options->track_active_chunks;
+  sim->maze.track_dirty_chunks = options->track_dirty_chunks;
+  sim->prune_unreachable = options->prune_unreachable;
+  sim->output_callback = options->output_callback;
+  sim->output_user_data = options->output_user_data;
+
+  if (options->compress_rows)
+  {
+    sim->maze.row_runs = push_struct(memory, RowRuns);
+    zero(sim->maze.row_runs, RowRuns);
+    sim->maze.row_runs->memory = memory;
+  }
+
+  if (!init_sim_threads(&sim->sim_threads, options->n_threads))
+  {
+    stop_sim_threads(&sim->sim_threads);
+    sim = 0;
+  }
+  else
+  {
+    init_parse_threads(&sim->parse_threads, &sim->sim_threads);
+  }
+
+  return sim;
+}
+
+
+void
+restart_sim(SimState *sim)
+{
+  delete_all_cars(&sim->cars);
+  sim->sim_steps = 0;
+  sim->n_input_car_ids = 0;
+  sim->n_outputs = 0;
+}
+
+
+void
+setup_loaded_maze(Memory *memory, SimState *sim)
+{
+  order_maze_chunks(&sim->maze, memory);
+
+  if (sim->prune_unreachable)
+  {
+    sim->n_pruned_cells = prune_unreachable_cells(&sim->maze, memory);
+  }
+
+  if (sim->corridors.enabled)
+  {
+    analyse_corridors(memory, &sim->corridors, &sim->maze);
+  }
+
+  reset_loops(&sim->loops);
+
+  restart_sim(sim);
+}
+
+
+b32
+load_sim_maze(Memory *memory, SimState *sim, const u8 *filename)
+{
+  b32 success = load_maze_file(&sim->maze, &sim->functions, memory, filename, &sim->parse_threads);
+  if (success)
+  {
+    setup_loaded_maze(memory, sim);
+  }
+
+  return success;
+}
+
+
+b32
+load_sim_maze(Memory *memory, SimState *sim, const u8 *data, size_t size)
+{
+  b32 success = load_maze_data(&sim->maze, &sim->functions, memory, data, size, &sim->parse_threads);
+  if (success)
+  {
+    setup_loaded_maze(memory, sim);
+  }
+
+  return success;
+}
+
+
+// NOTE: This writes the maze as it is, so should be done before the
+//         sim is run.
+b32
+compile_sim_maze(SimState *sim, const u8 *filename)
+{
+  b32 success = write_compiled_maze(&sim->maze, &sim->functions, filename);
+  return success;
+}
+
+
+void
+stop_sim(SimState *sim)
+{
+  stop_sim_threads(&sim->sim_threads);
+  stop_parse_threads(&sim->parse_threads);
+}
+
+
+// Runs a whole tick, then jumps over any following ticks where every
+//   car is in transit, up to a total of max_ticks.
+void
+step_sim(Memory *memory, SimState *sim, u32 max_ticks)
+{
+  perform_cells_sim_tick(memory, sim);
+  perform_cars_sim_tick(memory, sim);
+
+  move_cars(sim);
+
+  ++sim->sim_steps;
+
+  if (max_ticks > 1)
+  {
+    sim->sim_steps += skip_idle_ticks(&sim->cars, max_ticks - 1);
+  }
+}
+
+
+b32
+sim_finished(SimState *sim)
+{
+  b32 result = sim->sim_steps != 0 && sim->cars.first_block == 0;
+  return result;
+}
+
+
+u32
+get_sim_steps(SimState *sim)
+{
+  return sim->sim_steps;
+}
+
+
+u64
+get_n_pruned_cells(SimState *sim)
+{
+  return sim->n_pruned_cells;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+// The interface to the simulation on its own, without any rendering,
+//   UI or particle state. The GUI keeps a SimState alongside its own
+//   state for drawing, and reads the maze and cars directly through
+//   sim-state.h.
+//
+// Users of the libmazesim library use the C interface in mazesim-api.h
+//   instead, which wraps this.
+
+
+const u64 DEFAULT_SIM_MEMORY = megabytes_to_bytes(200);
+
+
+struct SimState;
+
+
+// Called for each output cell a car reaches, count is the number of
+//   identical cars the value is output for.
+typedef void (*SimOutputCallback)(void *user_data, s32 value, u64 count);
+
+
+struct SimOptions
+{
+  u32 n_threads;
+
+  b32 compress_corridors;
+  b32 accelerate_loops;
+  b32 merge_identical_cars;
+
+  // Store the maze as runs of cells along each row, see RowRuns. Corridors
+  //   aren't compressed in this mode.
+  b32 compress_rows;
+
+  // List the chunks holding cars at the start of each tick, see "Active
+  //   chunks" in cells-storage.h
+  b32 track_active_chunks;
+
+  // List the chunks whose cells change type, for the GUI to upload
+  b32 track_dirty_chunks;
+
+  // Remove the cells no car can reach as the maze is loaded, see
+  //   reachability.h
+  b32 prune_unreachable;
+
+  // NOTE: Outputs are printed to stdout when there is no callback.
+  SimOutputCallback output_callback;
+  void *output_user_data;
+};
+
+
+SimState *
+init_sim(Memory *memory, SimOptions *options);
+
+b32
+load_sim_maze(Memory *memory, SimState *sim, const u8 *filename);
+
+b32
+load_sim_maze(Memory *memory, SimState *sim, const u8 *data, size_t size);
+
+b32
+compile_sim_maze(SimState *sim, const u8 *filename);
+
+void
+restart_sim(SimState *sim);
+
+void
+stop_sim(SimState *sim);
+
+void
+step_sim(Memory *memory, SimState *sim, u32 max_ticks = MAX_U32);
+
+b32
+sim_finished(SimState *sim);
+
+u32
+get_sim_steps(SimState *sim);
+
+u64
+get_n_pruned_cells(SimState *sim);
\ No newline at end of file
@@ -122,7 +122,7 @@ ui_consume_mouse_clicks(UI *ui, Mouse *mouse, vec2 mouse_pos, u64 time_us)
 
 
 void
-open_cell_type_menu(GameState *game_state, Cell *cell_hovered_over, u64 time_us)
+open_cell_type_menu(GameState *game_state, Cell *cell_hovered_over, u32 cell_x, u32 cell_y, u64 time_us)
 {
   // Only update time if the menu wasn't already open
   if (game_state->ui.cell_type_menu.cell == 0)
@@ -130,11 +130,13 @@ open_cell_type_menu(GameState *game_state, Cell *cell_hovered_over, u64 time_us)
     game_state->ui.cell_type_menu.opened_on_frame = time_us;
   }
   game_state->ui.cell_type_menu.cell = cell_hovered_over;
+  game_state->ui.cell_type_menu.cell_x = cell_x;
+  game_state->ui.cell_type_menu.cell_y = cell_y;
 }
 
 
 void
-update_menu(Menu *menu, vec2 mouse, u64 time_us)
+update_menu(Maze *maze, MazeEdits *maze_edits, Menu *menu, vec2 mouse, u64 time_us)
 {
   menu->selected_selector.item_n = -1;
 
@@ -162,7 +164,7 @@ update_menu(Menu *menu, vec2 mouse, u64 time_us)
 
         if (menu->clicked)
         {
-          menu->cell->type = item->cell_type;
+          edit_cell_type(maze_edits, maze, menu->cell, menu->cell_x, menu->cell_y, item->cell_type);
           close_menu = true;
         }
       }
@@ -265,10 +267,11 @@ update_car_inputs(GameState *game_state, UI *ui, vec2 mouse, Inputs *inputs)
 
       if (car_input->done.activated || enter_in_input)
       {
-        Car *car = get_car_with_id(&game_state->cars, car_input->car_id);
-        assert(car);
+        Car car;
+        b32 found = get_car_with_id(&game_state->sim->cars, car_input->car_id, &car);
+        assert(found);
 
-        get_num(car_input->input.text, car_input->input.text+car_input->input.length, &car->value);
+        get_num(car_input->input.text, car_input->input.text+car_input->input.length, car_value(car));
 
         if (prev_car_input)
         {
@@ -304,7 +307,7 @@ update_car_inputs(GameState *game_state, UI *ui, vec2 mouse, Inputs *inputs)
 void
 update_ui(GameState *game_state, UI *ui, vec2 mouse, Inputs *inputs, u64 time_us)
 {
-  update_menu(&ui->cell_type_menu, mouse, time_us);
+  update_menu(&game_state->sim->maze, &game_state->maze_edits, &ui->cell_type_menu, mouse, time_us);
   update_car_inputs(game_state, ui, mouse, inputs);
 }
 
@@ -26,6 +26,8 @@ const u32 MAX_MENU_ITEMS = 32;
 struct Menu
 {
   Cell *cell;
+  u32 cell_x;
+  u32 cell_y;
   b32 clicked;
 
   MenuItem items[MAX_MENU_ITEMS];